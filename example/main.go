@@ -112,7 +112,9 @@ func main() {
 		case frame := <-cf:
 			log.Printf("got image: %d, %dx%d, %s",
 				frame.Sequence, frame.Width, frame.Height, frame.CaptureTime)
-			if err := writeFrameFile(frame, fmt.Sprintf("frame%d.jpg", frame.Sequence)); err != nil {
+			err := writeFrameFile(frame, fmt.Sprintf("frame%d.jpg", frame.Sequence))
+			frame.Release()
+			if err != nil {
 				log.Fatal("write frame:", err)
 			}
 		case <-tc:
@@ -1,11 +1,11 @@
 package uvc
 
-// #include <libuvc-binding.h>
+// #include <libuvc-cgo.h>
 import "C"
 import (
 	"bytes"
-	"io"
-	"log"
+	"sync"
+	"sync/atomic"
 	"time"
 	"unsafe"
 
@@ -43,8 +43,37 @@ const (
 	FRAME_FORMAT_COUNT FrameFormat = C.UVC_FRAME_FORMAT_COUNT
 )
 
-// Frame is an image frame received from the UVC device.
-// It implements io.Reader.
+// DemosaicMethod selects how raw Bayer frames are turned into colour pixels.
+type DemosaicMethod C.enum_uvc_demosaic_method
+
+const (
+	// Average of the nearest samples of each colour, cheap enough for preview
+	DEMOSAIC_BILINEAR DemosaicMethod = C.UVC_DEMOSAIC_BILINEAR
+	// Green interpolated along edges, red and blue as differences to green
+	DEMOSAIC_EDGE_AWARE DemosaicMethod = C.UVC_DEMOSAIC_EDGE_AWARE
+	// One pixel per 2x2 cell: half the width and height, no interpolation
+	DEMOSAIC_SUPERPIXEL DemosaicMethod = C.UVC_DEMOSAIC_SUPERPIXEL
+)
+
+// FrameError is a set of integrity problems found in a frame, see WithValidation.
+type FrameError uint8
+
+const (
+	// The device flagged an error in a payload of the frame, its data is missing
+	FRAME_ERROR_PAYLOAD FrameError = C.UVC_FRAME_ERROR_PAYLOAD
+	// MJPEG frame doesn't start with an SOI marker
+	FRAME_ERROR_NO_SOI FrameError = C.UVC_FRAME_ERROR_NO_SOI
+	// MJPEG frame doesn't end with an EOI marker, usually truncated
+	FRAME_ERROR_NO_EOI FrameError = C.UVC_FRAME_ERROR_NO_EOI
+	// MJPEG frame too small to hold an image of the stream's size
+	FRAME_ERROR_SIZE FrameError = C.UVC_FRAME_ERROR_SIZE
+)
+
+// Frame is an image frame received from the UVC device, in the format the
+// device sent it. It implements io.Reader; ConvertTo gets other formats.
+//
+// Frames are pooled: call Release once the frame is no longer needed, and
+// Retain before handing it to another consumer that will Release it too.
 type Frame struct {
 	// Width of image in pixels
 	Width int
@@ -58,59 +87,526 @@ type Frame struct {
 	Sequence uint32
 	// Estimate of system time when the device started capturing the image
 	CaptureTime time.Time
+	// System time the last payload of the frame arrived
+	ArrivalTime time.Time
+	// Raw device timestamps from the payload headers, in ticks of the device
+	// clock (StreamCtrl.ClockFrequency): PTS at the start of capture, and the
+	// SCR of the frame's last payload that carried one, together with the
+	// 11 bit USB SOF counter it was sampled in
+	PTS    uint32
+	SCR    uint32
+	SOF    uint16
+	HasPTS bool
+	HasSCR bool
+	// Integrity problems found by WithValidation, zero if none were found or the stream doesn't check
+	Errors FrameError
 	// Is the data buffer owned by the library?
 	// If true, the data buffer can be arbitrarily reallocated by frame conversion functions.
 	// If false, the data buffer will not be reallocated or freed by the library.
 	LibraryOwned bool
-	// Image data for this frame
-	data io.Reader
-	//  Metadata for this frame if available
+	// Payload header bytes past the standard fields, where devices put per-frame
+	// metadata such as exposure, gain or sensor timestamps. One entry per payload
+	// whose extension differs from the previous one: a length byte followed by
+	// that many bytes. Nil if the device sends none. Valid until Release.
 	Metadata []byte
 
-	frame *C.struct_uvc_frame
+	refs int32
+	// Image data for this frame
+	reader bytes.Reader
+	buf    []byte
+	// backs Metadata of frames that own their data
+	meta []byte
+	// stream the buffer is lent from, nil if the frame owns its data
+	lender *Stream
+	lent   unsafe.Pointer
+	// sequence number of the lent frame, libuvc checks it on release
+	lentSeq C.uint32_t
+	// ArrivalTime on libuvc's monotonic clock, in ns
+	arrivalNs C.int64_t
+	pool      *sync.Pool
+	frame     *C.struct_uvc_frame
+	// stream the frame came from, lends it MJPEG decoders
+	stream *Stream
+
+	// ConvertTo results, one per target format so that a result handed out
+	// is never overwritten by a conversion to another format; shared by all
+	// readers of the frame
+	convMu sync.Mutex
+	conv   [numConvFormats][]byte
+	// bit i set once conv[i] holds the converted image
+	convDone uint8
 }
 
+// ConvertTo target formats, indexes into Frame.conv
+const (
+	convRGB = iota
+	convBGR
+	convGRAY8
+	numConvFormats
+)
+
 func (fr *Frame) Read(b []byte) (int, error) {
-	return fr.data.Read(b)
+	return fr.reader.Read(b)
+}
+
+// Bytes returns the image data of the frame.
+// The slice is only valid until the frame is released.
+func (fr *Frame) Bytes() []byte {
+	return fr.buf
+}
+
+// Retain adds a reference to the frame, to be dropped again with Release.
+func (fr *Frame) Retain() {
+	atomic.AddInt32(&fr.refs, 1)
+}
+
+// Release drops a reference to the frame. When the last one is gone, a
+// buffer lent by the stream (WithZeroCopy) is handed back and the frame
+// returns to its pool; it must not be used after that.
+func (fr *Frame) Release() {
+	if !fr.unref() {
+		return
+	}
+
+	if fr.lender != nil {
+		fr.lender.releaseBuffer(fr.lent, fr.lentSeq)
+	}
+	fr.recycle()
+}
+
+// unref drops a reference and reports whether it was the last one.
+func (fr *Frame) unref() bool {
+	n := atomic.AddInt32(&fr.refs, -1)
+	if n < 0 {
+		panic("uvc: frame released more often than retained")
+	}
+	return n == 0
+}
+
+func (fr *Frame) recycle() {
+	if fr.lender != nil {
+		// the buffer was libuvc's, not ours to reuse
+		fr.buf = nil
+		fr.lender = nil
+		fr.lent = nil
+	}
+	fr.buf = fr.buf[:0]
+	fr.reader.Reset(nil)
+	fr.Metadata = nil
+	fr.frame = nil
+	for i := range fr.conv {
+		fr.conv[i] = fr.conv[i][:0]
+	}
+	fr.convDone = 0
+	fr.pool.Put(fr)
+}
+
+// grow makes room for n bytes of image data, keeping at least hint bytes
+// of capacity so the pooled buffer fits every frame of the stream.
+func (fr *Frame) grow(n, hint int) {
+	if cap(fr.buf) < n {
+		if hint < n {
+			hint = n
+		}
+		fr.buf = make([]byte, n, hint)
+	}
+	fr.buf = fr.buf[:n]
+}
+
+// lentBytes wraps n bytes of C memory at p without copying.
+func lentBytes(p unsafe.Pointer, n int) []byte {
+	if p == nil || n == 0 {
+		return nil
+	}
+	return (*[1 << 30]byte)(p)[:n:n]
 }
 
 //export go_frame_cb
 func go_frame_cb(frame *C.struct_uvc_frame, p unsafe.Pointer) {
-	fc := pointer.Restore(p).(chan *Frame)
-
-	switch FrameFormat(frame.frame_format) {
-	case FRAME_FORMAT_YUYV:
-		bgr := C.uvc_allocate_frame(C.size_t(frame.width * frame.height * 3))
-		if bgr == nil {
-			log.Println("unable to allocate bgr frame")
-			return
+	run := pointer.Restore(p).(*streamRun)
+	s := run.s
+
+	fr := s.newFrame()
+	fr.Width = int(frame.width)
+	fr.Height = int(frame.height)
+	fr.FrameFormat = FrameFormat(frame.frame_format)
+	fr.Step = int(frame.step)
+	fr.Sequence = uint32(frame.sequence)
+	fr.CaptureTime = time.Unix(int64(frame.capture_time.tv_sec), int64(frame.capture_time.tv_usec)*1000)
+	fr.ArrivalTime = time.Unix(int64(frame.arrival_time.tv_sec), int64(frame.arrival_time.tv_usec)*1000)
+	fr.arrivalNs = frame.arrival_ns
+	fr.PTS = uint32(frame.pts)
+	fr.SCR = uint32(frame.scr)
+	fr.SOF = uint16(frame.sof)
+	fr.HasPTS = frame.has_pts != 0
+	fr.HasSCR = frame.has_scr != 0
+	fr.Errors = FrameError(frame.errors)
+	fr.frame = frame
+
+	if run.opts.zeroCopy {
+		fr.LibraryOwned = false
+		fr.buf = lentBytes(frame.data, int(frame.data_bytes))
+		fr.lender = s
+		fr.lent = frame.data
+		fr.lentSeq = frame.sequence
+		if frame.metadata_bytes > 0 {
+			fr.Metadata = lentBytes(frame.metadata, int(frame.metadata_bytes))
+		}
+		fr.reader.Reset(fr.buf)
+		s.deliver(fr, run)
+		return
+	}
+
+	// libuvc always lends us the frame slot: copy it out once into the
+	// pooled buffer and hand the slot straight back.
+	fr.LibraryOwned = true
+	if run.opts.mjpegDHT && fr.FrameFormat == FRAME_FORMAT_MJPEG {
+		fr.grow(int(frame.data_bytes)+C.UVC_MJPEG_DHT_BYTES, int(s.ctrl.dwMaxVideoFrameSize)+C.UVC_MJPEG_DHT_BYTES)
+		n := C.uvc_mjpeg_copy_dht(unsafe.Pointer(&fr.buf[0]), frame.data, frame.data_bytes)
+		fr.buf = fr.buf[:n]
+	} else {
+		fr.grow(int(frame.data_bytes), int(s.ctrl.dwMaxVideoFrameSize))
+		copy(fr.buf, lentBytes(frame.data, int(frame.data_bytes)))
+	}
+	if frame.metadata_bytes > 0 {
+		// the frame's own small buffer, reused with the frame
+		fr.meta = append(fr.meta[:0], lentBytes(frame.metadata, int(frame.metadata_bytes))...)
+		fr.Metadata = fr.meta
+	}
+	C.uvc_stream_release_buffer(s.handle, frame.data, frame.sequence)
+
+	fr.reader.Reset(fr.buf)
+	s.deliver(fr, run)
+}
+
+// ConvertTo returns the image in format, converting it on the first call for
+// that format only; later calls, from any reader of the frame, reuse the
+// result. The frame's own format is returned as is.
+//
+// MJPEG frames decode to RGB, BGR or GRAY8 with the stream's pooled
+// libjpeg-turbo decoders.
+//
+// The result is copied into dst if it has the capacity, or into a new slice
+// if dst is too small. With a nil dst the frame's own buffer for that format
+// is returned; it is not changed by conversions to other formats, but is
+// only valid until the frame is released.
+func (fr *Frame) ConvertTo(format FrameFormat, dst []byte) ([]byte, error) {
+	if format == fr.FrameFormat {
+		return copyTo(dst, fr.buf), nil
+	}
+
+	var i, n int
+	switch format {
+	case FRAME_FORMAT_RGB:
+		i, n = convRGB, fr.Width*fr.Height*3
+	case FRAME_FORMAT_BGR:
+		i, n = convBGR, fr.Width*fr.Height*3
+	case FRAME_FORMAT_GRAY8:
+		i, n = convGRAY8, fr.Width*fr.Height
+	default:
+		return nil, newError(ERROR_NOT_SUPPORTED)
+	}
+
+	fr.convMu.Lock()
+	defer fr.convMu.Unlock()
+
+	if fr.convDone&(1<<i) == 0 {
+		if len(fr.buf) == 0 || n == 0 {
+			return nil, newError(ERROR_INVALID_PARAM)
 		}
-		defer C.uvc_free_frame(bgr)
 
-		r := C.uvc_any2bgr(frame, bgr)
-		if err := newError(ErrorType(r)); err != nil {
-			log.Println(err)
-			return
+		conv := fr.conv[i]
+		if cap(conv) < n {
+			conv = make([]byte, n)
+		}
+		conv = conv[:n]
+		fr.conv[i] = conv
+		if err := fr.convert(format, conv); err != nil {
+			return nil, err
 		}
-		frame = bgr
+		fr.convDone |= 1 << i
 	}
 
-	fr := &Frame{
-		Width:        int(frame.width),
-		Height:       int(frame.height),
-		FrameFormat:  FrameFormat(frame.frame_format),
-		Step:         int(frame.step),
-		Sequence:     uint32(frame.sequence),
-		LibraryOwned: frame.library_owns_data > 0,
-		CaptureTime:  time.Unix(int64(frame.capture_time.tv_sec), int64(frame.capture_time.tv_usec)*1000),
-		data:         bytes.NewReader(C.GoBytes(unsafe.Pointer(frame.data), C.int(frame.data_bytes))),
-		// Metadata:     C.GoBytes(unsafe.Pointer(frame.metadata), C.int(frame.metadata_bytes)),
-		frame: frame,
+	return copyTo(dst, fr.conv[i]), nil
+}
+
+// Luma extracts the Width x Height luma plane of a YUYV, UYVY, GRAY8 or
+// MJPEG frame, skipping chroma conversion. It is written to dst if it has the capacity, or
+// to a new slice otherwise; with a nil dst a GRAY8 frame returns its own
+// buffer, valid until the frame is released.
+func (fr *Frame) Luma(dst []byte) ([]byte, error) {
+	if fr.FrameFormat == FRAME_FORMAT_GRAY8 {
+		return copyTo(dst, fr.buf), nil
 	}
 
-	select {
-	case fc <- fr:
+	n := fr.Width * fr.Height
+	if len(fr.buf) == 0 || n == 0 {
+		return nil, newError(ERROR_INVALID_PARAM)
+	}
+
+	if cap(dst) < n {
+		dst = make([]byte, n)
+	}
+	dst = dst[:n]
+	if err := fr.convert(FRAME_FORMAT_GRAY8, dst); err != nil {
+		return nil, err
+	}
+	return dst, nil
+}
+
+// DecodeScaled decodes an MJPEG frame to format (RGB, BGR or GRAY8) at
+// 1/scale of its size, scale being 1, 2, 4 or 8. The image is
+// (Width+scale-1)/scale x (Height+scale-1)/scale pixels. The scaling is done
+// in the inverse DCT, so smaller images are also cheaper to decode. The
+// result is written to dst if it has the capacity, or to a new slice
+// otherwise.
+func (fr *Frame) DecodeScaled(format FrameFormat, scale int, dst []byte) ([]byte, error) {
+	if fr.FrameFormat != FRAME_FORMAT_MJPEG {
+		return nil, newError(ERROR_NOT_SUPPORTED)
+	}
+
+	var n int
+	switch format {
+	case FRAME_FORMAT_RGB, FRAME_FORMAT_BGR:
+		n = 3
+	case FRAME_FORMAT_GRAY8:
+		n = 1
 	default:
-		log.Printf("frame %d dropped", frame.sequence)
+		return nil, newError(ERROR_NOT_SUPPORTED)
+	}
+	if scale != 1 && scale != 2 && scale != 4 && scale != 8 {
+		return nil, newError(ERROR_INVALID_PARAM)
+	}
+	n *= (fr.Width + scale - 1) / scale * ((fr.Height + scale - 1) / scale)
+	if len(fr.buf) == 0 || n == 0 {
+		return nil, newError(ERROR_INVALID_PARAM)
+	}
+
+	if cap(dst) < n {
+		dst = make([]byte, n)
 	}
+	dst = dst[:n]
+
+	dec := fr.decoder()
+	if dec == nil {
+		return nil, newError(ERROR_NO_MEM)
+	}
+	defer fr.putDecoder(dec)
+
+	r := C.cgo_uvc_mjpeg_decode(dec, unsafe.Pointer(&fr.buf[0]), C.size_t(len(fr.buf)), C.int(scale),
+		C.enum_uvc_frame_format(format), unsafe.Pointer(&dst[0]), C.size_t(n))
+	if err := newError(ErrorType(r)); err != nil {
+		return nil, err
+	}
+	return dst, nil
+}
+
+// convert writes the image in format to out, which has its exact size.
+func (fr *Frame) convert(format FrameFormat, out []byte) error {
+	if fr.FrameFormat == FRAME_FORMAT_MJPEG {
+		dec := fr.decoder()
+		if dec == nil {
+			return newError(ERROR_NO_MEM)
+		}
+		defer fr.putDecoder(dec)
+
+		r := C.cgo_uvc_mjpeg_decode(dec, unsafe.Pointer(&fr.buf[0]), C.size_t(len(fr.buf)), 1,
+			C.enum_uvc_frame_format(format), unsafe.Pointer(&out[0]), C.size_t(len(out)))
+		return newError(ErrorType(r))
+	}
+
+	r := C.cgo_uvc_convert(C.enum_uvc_frame_format(fr.FrameFormat), C.uint32_t(fr.Width), C.uint32_t(fr.Height),
+		C.size_t(fr.Step), unsafe.Pointer(&fr.buf[0]), C.size_t(len(fr.buf)),
+		C.enum_uvc_frame_format(format), unsafe.Pointer(&out[0]), C.size_t(len(out)))
+	return newError(ErrorType(r))
+}
+
+// decoder borrows an MJPEG decoder from the frame's stream.
+func (fr *Frame) decoder() *C.uvc_mjpeg_decoder_t {
+	if fr.stream == nil {
+		return C.uvc_mjpeg_decoder_create()
+	}
+	return fr.stream.decoder()
+}
+
+func (fr *Frame) putDecoder(dec *C.uvc_mjpeg_decoder_t) {
+	if fr.stream == nil {
+		C.uvc_mjpeg_decoder_destroy(dec)
+		return
+	}
+	fr.stream.putDecoder(dec)
+}
+
+// Gray16 returns the samples of a GRAY16 frame, which UVC sends little
+// endian. On little endian hosts a nil dst gets a view of the frame's own
+// buffer, valid until the frame is released; otherwise the samples are
+// decoded into dst if it has the capacity, or into a new slice.
+func (fr *Frame) Gray16(dst []uint16) ([]uint16, error) {
+	if fr.FrameFormat != FRAME_FORMAT_GRAY16 {
+		return nil, newError(ERROR_INVALID_PARAM)
+	}
+
+	n := len(fr.buf) / 2
+	if dst == nil && littleEndian {
+		if n == 0 {
+			return nil, nil
+		}
+		return (*[1 << 29]uint16)(unsafe.Pointer(&fr.buf[0]))[:n:n], nil
+	}
+
+	if cap(dst) < n {
+		dst = make([]uint16, n)
+	}
+	dst = dst[:n]
+	for i := range dst {
+		dst[i] = uint16(fr.buf[2*i]) | uint16(fr.buf[2*i+1])<<8
+	}
+	return dst, nil
+}
+
+// littleEndian tells whether the host stores the low byte first.
+var littleEndian = func() bool {
+	x := uint16(1)
+	return *(*byte)(unsafe.Pointer(&x)) == 1
+}()
+
+// Demosaic converts a raw Bayer frame to format, RGB or BGR, using method.
+// ConvertTo demosaics bilinearly; this picks the algorithm and doesn't cache.
+// With DEMOSAIC_SUPERPIXEL the image is Width/2 x Height/2. The result is
+// written to dst if it has the capacity, or to a new slice otherwise.
+func (fr *Frame) Demosaic(method DemosaicMethod, format FrameFormat, dst []byte) ([]byte, error) {
+	w, h := fr.Width, fr.Height
+	if method == DEMOSAIC_SUPERPIXEL {
+		w, h = w/2, h/2
+	}
+	n := w * h * 3
+	if len(fr.buf) == 0 || n == 0 {
+		return nil, newError(ERROR_INVALID_PARAM)
+	}
+
+	if cap(dst) < n {
+		dst = make([]byte, n)
+	}
+	dst = dst[:n]
+	r := C.cgo_uvc_demosaic(C.enum_uvc_frame_format(fr.FrameFormat), C.uint32_t(fr.Width), C.uint32_t(fr.Height),
+		unsafe.Pointer(&fr.buf[0]), C.size_t(len(fr.buf)), C.enum_uvc_demosaic_method(method),
+		C.enum_uvc_frame_format(format), unsafe.Pointer(&dst[0]), C.size_t(n))
+	if err := newError(ErrorType(r)); err != nil {
+		return nil, err
+	}
+	return dst, nil
+}
+
+// ToNV12 converts a YUYV or UYVY frame of even width into the NV12 planes y
+// (Width x Height luma samples) and uv ((Height+1)/2 rows of Width/2
+// interleaved U, V pairs), averaging the chroma of each two rows. A stride
+// of 0 means rows are packed without padding.
+func (fr *Frame) ToNV12(y []byte, yStride int, uv []byte, uvStride int) error {
+	if yStride == 0 {
+		yStride = fr.Width
+	}
+	if uvStride == 0 {
+		uvStride = fr.Width
+	}
+	if !planeFits(y, yStride, fr.Width, fr.Height) ||
+		!planeFits(uv, uvStride, fr.Width, (fr.Height+1)/2) {
+		return newError(ERROR_INVALID_PARAM)
+	}
+	return fr.convertPlanar(y, yStride, uv, uvStride, nil, 0)
+}
+
+// ToI420 converts a YUYV or UYVY frame of even width into the I420 planes y
+// (Width x Height), u and v (Width/2 x (Height+1)/2 each), averaging the
+// chroma of each two rows. MJPEG frames in 4:2:0 or 4:2:2 decode straight
+// to the planes, skipping colour conversion. A stride of 0 means rows are packed without
+// padding.
+func (fr *Frame) ToI420(y []byte, yStride int, u []byte, uStride int, v []byte, vStride int) error {
+	if yStride == 0 {
+		yStride = fr.Width
+	}
+	if uStride == 0 {
+		uStride = fr.Width / 2
+	}
+	if vStride == 0 {
+		vStride = fr.Width / 2
+	}
+	if !planeFits(y, yStride, fr.Width, fr.Height) ||
+		!planeFits(u, uStride, fr.Width/2, (fr.Height+1)/2) ||
+		!planeFits(v, vStride, fr.Width/2, (fr.Height+1)/2) {
+		return newError(ERROR_INVALID_PARAM)
+	}
+	return fr.convertPlanar(y, yStride, u, uStride, v, vStride)
+}
+
+func (fr *Frame) convertPlanar(y []byte, yStride int, u []byte, uStride int, v []byte, vStride int) error {
+	if len(fr.buf) == 0 {
+		return newError(ERROR_INVALID_PARAM)
+	}
+
+	if fr.FrameFormat == FRAME_FORMAT_MJPEG {
+		if v == nil {
+			return newError(ERROR_NOT_SUPPORTED)
+		}
+		dec := fr.decoder()
+		if dec == nil {
+			return newError(ERROR_NO_MEM)
+		}
+		defer fr.putDecoder(dec)
+
+		r := C.cgo_uvc_mjpeg_decode_i420(dec, unsafe.Pointer(&fr.buf[0]), C.size_t(len(fr.buf)),
+			unsafe.Pointer(&y[0]), C.size_t(yStride), unsafe.Pointer(&u[0]), C.size_t(uStride),
+			unsafe.Pointer(&v[0]), C.size_t(vStride))
+		return newError(ErrorType(r))
+	}
+
+	var pv unsafe.Pointer
+	if v != nil {
+		pv = unsafe.Pointer(&v[0])
+	}
+	r := C.cgo_uvc_convert_planar(C.enum_uvc_frame_format(fr.FrameFormat), C.uint32_t(fr.Width), C.uint32_t(fr.Height),
+		C.size_t(fr.Step), unsafe.Pointer(&fr.buf[0]), C.size_t(len(fr.buf)),
+		unsafe.Pointer(&y[0]), C.size_t(yStride), unsafe.Pointer(&u[0]), C.size_t(uStride),
+		pv, C.size_t(vStride))
+	return newError(ErrorType(r))
+}
+
+// planeFits reports whether p holds rows rows of width bytes, stride apart.
+func planeFits(p []byte, stride, width, rows int) bool {
+	return width > 0 && rows > 0 && stride >= width && len(p) >= stride*(rows-1)+width
+}
+
+// copyTo copies src into dst, or returns src itself if dst is nil.
+func copyTo(dst, src []byte) []byte {
+	if dst == nil {
+		return src
+	}
+	if cap(dst) < len(src) {
+		dst = make([]byte, len(src))
+	}
+	dst = dst[:len(src)]
+	copy(dst, src)
+	return dst
+}
+
+// SetConversionThreads sets how many threads a frame conversion may use.
+// Large frames are split into row bands shared by the converting goroutine
+// and n-1 persistent workers; 1, the default, converts on the calling
+// goroutine only.
+func SetConversionThreads(n int) error {
+	return newError(ErrorType(C.uvc_set_conversion_threads(C.int(n))))
+}
+
+// setSIMD switches the conversion kernels between the SIMD ones the CPU
+// supports and the scalar ones, to check and benchmark them against each other.
+func setSIMD(enable bool) {
+	var e C.int
+	if enable {
+		e = 1
+	}
+	C.uvc_set_simd(e)
+}
+
+// ConversionThreads returns the number of threads a frame conversion may use.
+func ConversionThreads() int {
+	return int(C.uvc_get_conversion_threads())
 }
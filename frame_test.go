@@ -0,0 +1,164 @@
+package uvc
+
+import (
+	"bytes"
+	"fmt"
+	"math/rand"
+	"testing"
+)
+
+var packedFormats = []struct {
+	name   string
+	format FrameFormat
+}{
+	{"YUYV", FRAME_FORMAT_YUYV},
+	{"UYVY", FRAME_FORMAT_UYVY},
+}
+
+var frameSizes = []struct{ w, h int }{
+	{640, 480},
+	{1920, 1080},
+	{3840, 2160},
+}
+
+func packedFrame(format FrameFormat, w, h int) *Frame {
+	buf := make([]byte, w*h*2)
+	rand.New(rand.NewSource(int64(w * h))).Read(buf)
+	return &Frame{Width: w, Height: h, FrameFormat: format, Step: w * 2, buf: buf}
+}
+
+// TestConvertSIMD checks that the SIMD kernels convert exactly like the
+// scalar ones, with and without a tail of pixels the vector loops leave over,
+// and with packed and padded rows.
+func TestConvertSIMD(t *testing.T) {
+	defer setSIMD(true)
+
+	sizes := append([]struct{ w, h int }{{2, 1}, {34, 3}, {642, 5}}, frameSizes...)
+	for _, in := range packedFormats {
+		for _, sz := range sizes {
+			packed := packedFrame(in.format, sz.w, sz.h)
+			for _, fr := range []*Frame{packed, paddedFrame(packed, 12)} {
+				for _, out := range []FrameFormat{FRAME_FORMAT_RGB, FRAME_FORMAT_BGR, FRAME_FORMAT_GRAY8} {
+					n := sz.w * sz.h * 3
+					if out == FRAME_FORMAT_GRAY8 {
+						n = sz.w * sz.h
+					}
+					want, got := make([]byte, n), make([]byte, n)
+
+					setSIMD(false)
+					if err := fr.convert(out, want); err != nil {
+						t.Fatal(err)
+					}
+					setSIMD(true)
+					if err := fr.convert(out, got); err != nil {
+						t.Fatal(err)
+					}
+					if i := mismatch(want, got); i >= 0 {
+						t.Errorf("%s to format %d at %dx%d, step %d: byte %d is %d, scalar %d",
+							in.name, out, sz.w, sz.h, fr.Step, i, got[i], want[i])
+					}
+				}
+			}
+		}
+	}
+}
+
+// paddedFrame copies a packed frame into rows of pad more bytes, filled with
+// garbage a conversion must not pick up.
+func paddedFrame(fr *Frame, pad int) *Frame {
+	row := fr.Width * 2
+	p := *fr
+	p.Step = row + pad
+	p.buf = bytes.Repeat([]byte{0xa5}, p.Step*fr.Height)
+	for y := 0; y < fr.Height; y++ {
+		copy(p.buf[y*p.Step:], fr.buf[y*row:(y+1)*row])
+	}
+	return &p
+}
+
+// TestConvertStep checks that conversions of frames with padded rows
+// come out like those of the same frames packed.
+func TestConvertStep(t *testing.T) {
+	const w, h = 70, 9
+	for _, in := range packedFormats {
+		fr := packedFrame(in.format, w, h)
+		padded := paddedFrame(fr, 12)
+
+		for _, out := range []struct {
+			name   string
+			format FrameFormat
+			n      int
+		}{
+			{"RGB", FRAME_FORMAT_RGB, w * h * 3},
+			{"BGR", FRAME_FORMAT_BGR, w * h * 3},
+			{"GRAY8", FRAME_FORMAT_GRAY8, w * h},
+		} {
+			want, got := make([]byte, out.n), make([]byte, out.n)
+			if err := fr.convert(out.format, want); err != nil {
+				t.Fatal(err)
+			}
+			if err := padded.convert(out.format, got); err != nil {
+				t.Fatal(err)
+			}
+			if i := mismatch(want, got); i >= 0 {
+				t.Errorf("%s to %s: byte %d is %d, packed %d", in.name, out.name, i, got[i], want[i])
+			}
+		}
+
+		const chroma = w / 2 * ((h + 1) / 2)
+		want, got := make([]byte, w*h+2*chroma), make([]byte, w*h+2*chroma)
+		for _, c := range []struct {
+			fr  *Frame
+			out []byte
+		}{{fr, want}, {padded, got}} {
+			y, u, v := c.out[:w*h], c.out[w*h:w*h+chroma], c.out[w*h+chroma:]
+			if err := c.fr.ToI420(y, 0, u, 0, v, 0); err != nil {
+				t.Fatal(err)
+			}
+		}
+		if i := mismatch(want, got); i >= 0 {
+			t.Errorf("%s to I420: byte %d is %d, packed %d", in.name, i, got[i], want[i])
+		}
+	}
+}
+
+func mismatch(a, b []byte) int {
+	if bytes.Equal(a, b) {
+		return -1
+	}
+	for i := range a {
+		if a[i] != b[i] {
+			return i
+		}
+	}
+	return len(a)
+}
+
+// BenchmarkConvertRGB converts YUYV and UYVY frames to RGB with the SIMD
+// kernels and the scalar ones, on the calling goroutine only.
+func BenchmarkConvertRGB(b *testing.B) {
+	defer setSIMD(true)
+
+	for _, in := range packedFormats {
+		for _, sz := range frameSizes {
+			for _, simd := range []bool{true, false} {
+				kernels := "simd"
+				if !simd {
+					kernels = "scalar"
+				}
+				b.Run(fmt.Sprintf("%s/%dx%d/%s", in.name, sz.w, sz.h, kernels), func(b *testing.B) {
+					fr := packedFrame(in.format, sz.w, sz.h)
+					out := make([]byte, sz.w*sz.h*3)
+					setSIMD(simd)
+					b.SetBytes(int64(len(fr.buf)))
+					b.ResetTimer()
+					for i := 0; i < b.N; i++ {
+						if err := fr.convert(FRAME_FORMAT_RGB, out); err != nil {
+							b.Fatal(err)
+						}
+					}
+				})
+			}
+		}
+	}
+}
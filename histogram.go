@@ -0,0 +1,142 @@
+package uvc
+
+// #include <libuvc-binding.h>
+import "C"
+import (
+	"sync/atomic"
+	"time"
+)
+
+// HISTOGRAM_BUCKETS is the number of buckets of a Histogram.
+const HISTOGRAM_BUCKETS = C.UVC_HIST_BUCKETS
+
+// Histogram is a fixed-bucket histogram of durations with microsecond
+// resolution. Buckets 0 to 7 hold 0 to 7µs; above that, every power of two
+// is split in eight, so no bucket is wider than 12.5% of its lower bound.
+// The last bucket also takes everything longer, from about 8s.
+// HistogramBucket tells the range of a bucket.
+type Histogram struct {
+	Buckets [HISTOGRAM_BUCKETS]uint64
+	Count   uint64
+	Sum     time.Duration
+	Min     time.Duration
+	Max     time.Duration
+}
+
+// Mean returns the average duration, 0 if the histogram is empty.
+func (h *Histogram) Mean() time.Duration {
+	if h.Count == 0 {
+		return 0
+	}
+	return h.Sum / time.Duration(h.Count)
+}
+
+// Quantile returns the upper bound of the bucket holding the q-quantile
+// (0 <= q <= 1), capped by Max. It is 0 if the histogram is empty.
+func (h *Histogram) Quantile(q float64) time.Duration {
+	if h.Count == 0 {
+		return 0
+	}
+	rank := uint64(q*float64(h.Count) + 0.5)
+	if rank < 1 {
+		rank = 1
+	}
+
+	var n uint64
+	for i, c := range h.Buckets {
+		n += c
+		if n >= rank {
+			if _, hi := HistogramBucket(i); hi < h.Max {
+				return hi
+			}
+			break
+		}
+	}
+	return h.Max
+}
+
+// HistogramBucket returns the range [lo, hi) of durations that bucket i of a
+// Histogram counts.
+func HistogramBucket(i int) (lo, hi time.Duration) {
+	if i < 8 {
+		return time.Duration(i) * time.Microsecond, time.Duration(i+1) * time.Microsecond
+	}
+	e := uint(i/8 + 2)
+	width := uint64(1) << (e - 3)
+	start := uint64(1)<<e + uint64(i%8)*width
+	return time.Duration(start) * time.Microsecond, time.Duration(start+width) * time.Microsecond
+}
+
+// histBucket returns the bucket of a duration of us microseconds, like libuvc.
+func histBucket(us uint64) int {
+	if us < 8 {
+		return int(us)
+	}
+	e := 0
+	for us>>(e+1) != 0 {
+		e++
+	}
+	b := (e-2)*8 + int((us>>(e-3))&7)
+	if b >= HISTOGRAM_BUCKETS {
+		b = HISTOGRAM_BUCKETS - 1
+	}
+	return b
+}
+
+// histogramCounters are a Histogram updated atomically, without locks.
+// They must be 64-bit aligned.
+type histogramCounters struct {
+	buckets [HISTOGRAM_BUCKETS]uint64
+	count   uint64
+	sumUs   uint64
+	// minimum plus one, so that zero means no value yet
+	minUs1 uint64
+	maxUs  uint64
+}
+
+func (h *histogramCounters) add(d time.Duration) {
+	if d < 0 {
+		d = 0
+	}
+	us := uint64(d / time.Microsecond)
+
+	atomic.AddUint64(&h.buckets[histBucket(us)], 1)
+	atomic.AddUint64(&h.sumUs, us)
+	for {
+		old := atomic.LoadUint64(&h.minUs1)
+		if (old != 0 && old <= us+1) || atomic.CompareAndSwapUint64(&h.minUs1, old, us+1) {
+			break
+		}
+	}
+	for {
+		old := atomic.LoadUint64(&h.maxUs)
+		if old >= us || atomic.CompareAndSwapUint64(&h.maxUs, old, us) {
+			break
+		}
+	}
+	// last, so a snapshot never counts more values than it has seen the sum of
+	atomic.AddUint64(&h.count, 1)
+}
+
+func (h *histogramCounters) snapshot(out *Histogram) {
+	out.Count = atomic.LoadUint64(&h.count)
+	for i := range h.buckets {
+		out.Buckets[i] = atomic.LoadUint64(&h.buckets[i])
+	}
+	out.Sum = time.Duration(atomic.LoadUint64(&h.sumUs)) * time.Microsecond
+	if min := atomic.LoadUint64(&h.minUs1); min != 0 {
+		out.Min = time.Duration(min-1) * time.Microsecond
+	}
+	out.Max = time.Duration(atomic.LoadUint64(&h.maxUs)) * time.Microsecond
+}
+
+// histogramFromC converts a libuvc histogram.
+func histogramFromC(h *C.uvc_histogram_t, out *Histogram) {
+	for i := range out.Buckets {
+		out.Buckets[i] = uint64(h.buckets[i])
+	}
+	out.Count = uint64(h.count)
+	out.Sum = time.Duration(h.sum_us) * time.Microsecond
+	out.Min = time.Duration(h.min_us) * time.Microsecond
+	out.Max = time.Duration(h.max_us) * time.Microsecond
+}
@@ -113,6 +113,18 @@ enum uvc_frame_format {
   UVC_FRAME_FORMAT_COUNT,
 };
 
+/** Demosaic algorithms for raw Bayer frames
+ * @see uvc_bayer2rgb
+ */
+enum uvc_demosaic_method {
+  /** Average of the nearest samples of each colour, cheap enough for preview */
+  UVC_DEMOSAIC_BILINEAR = 0,
+  /** Green interpolated along edges, red and blue as differences to green */
+  UVC_DEMOSAIC_EDGE_AWARE,
+  /** One pixel per 2x2 cell: half the width and height, no interpolation */
+  UVC_DEMOSAIC_SUPERPIXEL,
+};
+
 /* UVC_COLOR_FORMAT_* have been replaced with UVC_FRAME_FORMAT_*. Please use
  * UVC_FRAME_FORMAT_* instead of using these. */
 #define UVC_COLOR_FORMAT_UNKNOWN UVC_FRAME_FORMAT_UNKNOWN
@@ -467,6 +479,31 @@ typedef struct uvc_frame {
   uint32_t sequence;
   /** Estimate of system time when the device started capturing the image */
   struct timeval capture_time;
+  /** Presentation time stamp from the payload headers: device clock
+   * (dwClockFrequency) at the start of capture. Valid if has_pts is set. */
+  uint32_t pts;
+  /** Source clock reference of the frame's last payload that carried one:
+   * device clock (scr) and 11 bit USB SOF counter (sof) it was sampled in.
+   * Valid if has_scr is set. */
+  uint32_t scr;
+  uint16_t sof;
+  uint8_t has_pts;
+  uint8_t has_scr;
+  /** System time the last payload of the frame arrived */
+  struct timeval arrival_time;
+  /** The same instant on the host monotonic clock, in ns, for measuring
+   * latency against uvc_monotonic_ns() */
+  int64_t arrival_ns;
+  /** Integrity problems found by UVC_STREAM_FLAG_VALIDATE (enum
+   * uvc_frame_error), 0 if none were found or the stream doesn't check */
+  uint8_t errors;
+  /** Payload header bytes past the standard fields, where devices put
+   * per-frame metadata such as exposure, gain or sensor timestamps (UVC 1.5
+   * / Microsoft metadata). One entry per payload whose extension differs
+   * from the previous one: a length byte followed by that many bytes. Owned
+   * by the stream, valid as long as the frame data. */
+  void *metadata;
+  size_t metadata_bytes;
   /** Handle on the device that produced the image.
    * @warning You must not call any uvc_* functions during a callback. */
   uvc_device_handle_t *source;
@@ -484,6 +521,96 @@ typedef struct uvc_frame {
  */
 typedef void(uvc_frame_callback_t)(struct uvc_frame *frame, void *user_ptr);
 
+/** Stream setup flags, passed to uvc_stream_start()
+ * @ingroup streaming
+ */
+enum uvc_stream_flags {
+  /** Lend the assembled frame buffer to the consumer instead of copying it
+   * into the frame. The frame data stays valid until it is handed back with
+   * uvc_stream_release_buffer(). */
+  UVC_STREAM_FLAG_ZERO_COPY = (1 << 1),
+  /** Bulk streams only: receive each transfer straight into the frame
+   * buffer at the current write offset, so only the payload header is
+   * stripped and the image data is never copied. This keeps a single
+   * transfer in flight, since the offset of the next one is only known once
+   * the current one completes; use it with a large dwMaxPayloadTransferSize. */
+  UVC_STREAM_FLAG_DIRECT_BULK = (1 << 2),
+  /** Check each completed frame before it is published: the payload error
+   * bit for every format, and the SOI/EOI markers and a plausible size for
+   * MJPEG. Corrupt frames are dropped and counted in uvc_stream_stats_t. */
+  UVC_STREAM_FLAG_VALIDATE = (1 << 3),
+  /** With UVC_STREAM_FLAG_VALIDATE, deliver corrupt frames with
+   * uvc_frame_t.errors set instead of dropping them */
+  UVC_STREAM_FLAG_KEEP_CORRUPT = (1 << 4),
+  /** MJPEG streams: add the standard Huffman tables to frames that come
+   * without them while the frame is copied out of its slot, see
+   * uvc_mjpeg_copy_dht(). Lent frames (UVC_STREAM_FLAG_ZERO_COPY) are
+   * delivered as the device sent them. */
+  UVC_STREAM_FLAG_MJPEG_DHT = (1 << 5)
+};
+
+/** Integrity problems of a frame, see UVC_STREAM_FLAG_VALIDATE
+ * @ingroup streaming
+ */
+enum uvc_frame_error {
+  /** The device set the error bit in a payload header of the frame; the
+   * data of that payload is missing */
+  UVC_FRAME_ERROR_PAYLOAD = (1 << 0),
+  /** MJPEG frame doesn't start with an SOI marker */
+  UVC_FRAME_ERROR_NO_SOI = (1 << 1),
+  /** MJPEG frame doesn't end with an EOI marker, usually truncated */
+  UVC_FRAME_ERROR_NO_EOI = (1 << 2),
+  /** MJPEG frame too small to hold an image of the stream's size */
+  UVC_FRAME_ERROR_SIZE = (1 << 3)
+};
+
+/** Number of buckets of a uvc_histogram_t */
+#define UVC_HIST_BUCKETS 168
+
+/** Fixed-bucket histogram of durations in microseconds
+ * @ingroup streaming
+ *
+ * Buckets 0 to 7 hold 0 to 7 us. Above that, every power of two is split in
+ * eight, so no bucket is wider than 12.5% of its lower bound: a duration of
+ * us microseconds with e = floor(log2(us)) falls into bucket
+ * (e - 2) * 8 + ((us >> (e - 3)) & 7). The last bucket also takes
+ * everything longer, from about 8 s.
+ */
+typedef struct uvc_histogram {
+  uint32_t buckets[UVC_HIST_BUCKETS];
+  uint32_t count;
+  uint64_t sum_us;
+  uint32_t min_us;
+  uint32_t max_us;
+} uvc_histogram_t;
+
+/** Stream counters, see uvc_stream_get_stats()
+ * @ingroup streaming
+ */
+typedef struct uvc_stream_stats {
+  /** Frames completed by the device */
+  uint32_t frames;
+  /** Completed frames discarded because every frame slot was in use */
+  uint32_t dropped_frames;
+  /** Times a frame slot was enlarged because the device sent more than
+   * dwMaxVideoFrameSize */
+  uint32_t grown_slots;
+  /** Frames discarded because they exceeded LIBUVC_MAX_FRAME_SIZE */
+  uint32_t overflowed_frames;
+  /** Frames found corrupt by UVC_STREAM_FLAG_VALIDATE, by problem; a
+   * frame may count towards several */
+  uint32_t payload_errors;
+  uint32_t missing_soi;
+  uint32_t missing_eoi;
+  uint32_t bad_size;
+  /** Corrupt frames discarded, unless UVC_STREAM_FLAG_KEEP_CORRUPT is set */
+  uint32_t corrupt_frames;
+  /** Time between the ends of consecutive frames completed by the device */
+  uvc_histogram_t frame_intervals;
+  /** Frames that ended more than 1.5 dwFrameInterval after the previous one */
+  uint32_t late_frames;
+} uvc_stream_stats_t;
+
 /** Streaming mode, includes all information needed to select stream
  * @ingroup streaming
  */
@@ -590,6 +717,8 @@ uvc_error_t uvc_start_iso_streaming(
 void uvc_stop_streaming(uvc_device_handle_t *devh);
 
 uvc_error_t uvc_stream_open_ctrl(uvc_device_handle_t *devh, uvc_stream_handle_t **strmh, uvc_stream_ctrl_t *ctrl);
+uvc_error_t uvc_stream_open_ctrl_slots(uvc_device_handle_t *devh, uvc_stream_handle_t **strmh, uvc_stream_ctrl_t *ctrl,
+    int num_slots);
 uvc_error_t uvc_stream_ctrl(uvc_stream_handle_t *strmh, uvc_stream_ctrl_t *ctrl);
 uvc_error_t uvc_stream_start(uvc_stream_handle_t *strmh,
     uvc_frame_callback_t *cb,
@@ -603,6 +732,13 @@ uvc_error_t uvc_stream_get_frame(
     uvc_frame_t **frame,
     int32_t timeout_us
 );
+uvc_error_t uvc_stream_set_transfers(uvc_stream_handle_t *strmh, int num_transfers, int packets_per_transfer);
+void uvc_stream_get_transfers(uvc_stream_handle_t *strmh, int *num_transfers, int *packets_per_transfer,
+    size_t *transfer_size, int *dev_mem_transfers);
+void uvc_stream_release_buffer(uvc_stream_handle_t *strmh, void *data, uint32_t sequence);
+int uvc_stream_lent_buffers(uvc_stream_handle_t *strmh);
+void uvc_stream_get_stats(uvc_stream_handle_t *strmh, uvc_stream_stats_t *stats);
+int64_t uvc_monotonic_ns(void);
 uvc_error_t uvc_stream_stop(uvc_stream_handle_t *strmh);
 void uvc_stream_close(uvc_stream_handle_t *strmh);
 
@@ -745,6 +881,10 @@ void uvc_free_frame(uvc_frame_t *frame);
 
 uvc_error_t uvc_duplicate_frame(uvc_frame_t *in, uvc_frame_t *out);
 
+uvc_error_t uvc_set_conversion_threads(int num_threads);
+int uvc_get_conversion_threads(void);
+void uvc_set_simd(int enable);
+
 uvc_error_t uvc_yuyv2rgb(uvc_frame_t *in, uvc_frame_t *out);
 uvc_error_t uvc_uyvy2rgb(uvc_frame_t *in, uvc_frame_t *out);
 uvc_error_t uvc_any2rgb(uvc_frame_t *in, uvc_frame_t *out);
@@ -753,11 +893,50 @@ uvc_error_t uvc_yuyv2bgr(uvc_frame_t *in, uvc_frame_t *out);
 uvc_error_t uvc_uyvy2bgr(uvc_frame_t *in, uvc_frame_t *out);
 uvc_error_t uvc_any2bgr(uvc_frame_t *in, uvc_frame_t *out);
 
+uvc_error_t uvc_bayer2rgb(uvc_frame_t *in, uvc_frame_t *out, enum uvc_demosaic_method method);
+uvc_error_t uvc_bayer2bgr(uvc_frame_t *in, uvc_frame_t *out, enum uvc_demosaic_method method);
+
+uvc_error_t uvc_yuyv2nv12(uvc_frame_t *in, uint8_t *y, size_t y_stride, uint8_t *uv, size_t uv_stride);
+uvc_error_t uvc_uyvy2nv12(uvc_frame_t *in, uint8_t *y, size_t y_stride, uint8_t *uv, size_t uv_stride);
+uvc_error_t uvc_any2nv12(uvc_frame_t *in, uint8_t *y, size_t y_stride, uint8_t *uv, size_t uv_stride);
+
+uvc_error_t uvc_yuyv2i420(uvc_frame_t *in, uint8_t *y, size_t y_stride,
+                          uint8_t *u, size_t u_stride, uint8_t *v, size_t v_stride);
+uvc_error_t uvc_uyvy2i420(uvc_frame_t *in, uint8_t *y, size_t y_stride,
+                          uint8_t *u, size_t u_stride, uint8_t *v, size_t v_stride);
+uvc_error_t uvc_any2i420(uvc_frame_t *in, uint8_t *y, size_t y_stride,
+                         uint8_t *u, size_t u_stride, uint8_t *v, size_t v_stride);
+
 uvc_error_t uvc_yuyv2y(uvc_frame_t *in, uvc_frame_t *out);
+uvc_error_t uvc_uyvy2y(uvc_frame_t *in, uvc_frame_t *out);
+uvc_error_t uvc_any2y(uvc_frame_t *in, uvc_frame_t *out);
 uvc_error_t uvc_yuyv2uv(uvc_frame_t *in, uvc_frame_t *out);
 
+/** Size of the DHT segment uvc_mjpeg_copy_dht() may add to a frame */
+#define UVC_MJPEG_DHT_BYTES 420
+
+size_t uvc_mjpeg_copy_dht(void *dst, const void *src, size_t bytes);
+uvc_error_t uvc_mjpeg_insert_dht(uvc_frame_t *in, uvc_frame_t *out);
+
 #ifdef LIBUVC_HAS_JPEG
+/** Reusable MJPEG decoder
+ * @see uvc_mjpeg_decoder_create
+ */
+typedef struct uvc_mjpeg_decoder uvc_mjpeg_decoder_t;
+
+uvc_mjpeg_decoder_t *uvc_mjpeg_decoder_create(void);
+void uvc_mjpeg_decoder_destroy(uvc_mjpeg_decoder_t *dec);
+uvc_error_t uvc_mjpeg_decode(uvc_mjpeg_decoder_t *dec, uvc_frame_t *in, uvc_frame_t *out,
+                             enum uvc_frame_format format);
+uvc_error_t uvc_mjpeg_decode_scaled(uvc_mjpeg_decoder_t *dec, uvc_frame_t *in, uvc_frame_t *out,
+                                    enum uvc_frame_format format, int scale_denom);
+uvc_error_t uvc_mjpeg_decode_i420(uvc_mjpeg_decoder_t *dec, uvc_frame_t *in,
+                                  uint8_t *y, size_t y_stride,
+                                  uint8_t *u, size_t u_stride, uint8_t *v, size_t v_stride);
+
 uvc_error_t uvc_mjpeg2rgb(uvc_frame_t *in, uvc_frame_t *out);
+uvc_error_t uvc_mjpeg2bgr(uvc_frame_t *in, uvc_frame_t *out);
+uvc_error_t uvc_mjpeg2gray(uvc_frame_t *in, uvc_frame_t *out);
 #endif
 
 #ifdef __cplusplus
@@ -1469,17 +1648,122 @@ typedef struct uvc_device_info {
 } uvc_device_info_t;
 
 /*
-  set a high number of transfer buffers. This uses a lot of ram, but
-  avoids problems with scheduling delays on slow boards causing missed
-  transfers. A better approach may be to make the transfer thread FIFO
-  scheduled (if we have root).
-  We could/should change this to allow reduce it to, say, 5 by default
-  and then allow the user to change the number of buffers as required.
+  Upper bound on the transfers a stream keeps in flight. Unless set with
+  uvc_stream_set_transfers, enough transfers are queued to cover
+  LIBUVC_TRANSFER_QUEUE_US or two frame intervals, whichever is longer, of
+  the negotiated bandwidth. More transfers absorb scheduling delays on slow
+  boards at the cost of ram.
  */
 #define LIBUVC_NUM_TRANSFER_BUFS 100
+#define LIBUVC_MIN_TRANSFER_BUFS 2
+#define LIBUVC_TRANSFER_QUEUE_US 100000
+
+/* Default cap and upper bound on the packets per isochronous transfer */
+#define LIBUVC_ISO_PACKETS 32
+#define LIBUVC_MAX_ISO_PACKETS 1024
 
 #define LIBUVC_XFER_BUF_SIZE	( 16 * 1024 * 1024 )
 
+/* Frame slots are sized from the negotiated dwMaxVideoFrameSize (or
+ * LIBUVC_XFER_BUF_SIZE if the device reports none) and grown on demand for
+ * devices that overrun it, but never beyond this. */
+#define LIBUVC_MAX_FRAME_SIZE	( 64 * 1024 * 1024 )
+
+/* Upper bound for uvc_set_conversion_threads */
+#define LIBUVC_MAX_CONVERSION_THREADS 64
+/* Smallest band of pixels worth handing to a conversion worker */
+#define LIBUVC_CONVERSION_BAND_PIXELS 65536
+
+/* Bytes reserved in front of each frame slot, so that a direct bulk transfer
+ * can put the payload header (at most 255 bytes) before the image data */
+#define LIBUVC_SLOT_HEADROOM 256
+
+/* Default number of frame buffers per stream. One is always being filled by
+ * the transfer callbacks, the others hold completed frames until the consumer
+ * gets to them. */
+#define LIBUVC_NUM_FRAME_SLOTS 2
+#define LIBUVC_MAX_FRAME_SLOTS 64
+
+/* Payload header extension bytes kept per frame, see uvc_frame_t.metadata.
+ * Entries that don't fit anymore are dropped. */
+#define LIBUVC_METADATA_SIZE 2048
+
+/* Frames the fit between device clock and USB SOF counter spans */
+#define LIBUVC_CLOCK_SAMPLES 32
+
+/** Minimum of the values seen over the last one to two seconds */
+struct uvc_clock_min {
+  int64_t cur;
+  int64_t prev;
+  int64_t start_ns;
+};
+
+/** Device to host clock recovery of a stream
+ *
+ * The SCR of the payload headers pairs the device clock (STC, running at
+ * dwClockFrequency) with the USB SOF counter it was sampled in. The SOF
+ * counter is the host controller's millisecond clock, so the pairs fit a
+ * line that needs no host timestamps, and host time of an SOF is the least
+ * delayed arrival of a payload sent in it. A PTS is mapped along both.
+ * Devices with a bogus SOF counter fall back to pairing STC with arrival
+ * time directly. Owned by the transfer callbacks.
+ */
+struct uvc_clock {
+  /** device clock frequency in Hz, 0 if unknown */
+  uint32_t freq;
+  /** set once an SCR has been seen */
+  uint8_t valid;
+  /** latest SCR: raw and unwrapped STC and SOF, arrival (host monotonic) */
+  uint32_t stc_raw;
+  uint16_t sof_raw;
+  int64_t stc;
+  int64_t sof;
+  int64_t host_ns;
+  /** one (STC, SOF) pair per frame, ring of LIBUVC_CLOCK_SAMPLES */
+  int64_t sample_stc[LIBUVC_CLOCK_SAMPLES];
+  int64_t sample_sof[LIBUVC_CLOCK_SAMPLES];
+  int head;
+  int count;
+  /** host time minus SOF (ms) and minus STC, in ns */
+  struct uvc_clock_min sof_offset;
+  struct uvc_clock_min stc_offset;
+};
+
+enum uvc_frame_slot_state {
+  UVC_FRAME_SLOT_FREE = 0,
+  /** being assembled from payloads */
+  UVC_FRAME_SLOT_FILLING,
+  /** complete, waiting for the consumer */
+  UVC_FRAME_SLOT_READY,
+  /** lent to the consumer (UVC_STREAM_FLAG_ZERO_COPY) */
+  UVC_FRAME_SLOT_LENT
+};
+
+/** One frame buffer of a stream's ring */
+struct uvc_frame_slot {
+  /** allocation, buf starts LIBUVC_SLOT_HEADROOM bytes into it */
+  uint8_t *mem;
+  uint8_t *buf;
+  /** allocated size of buf */
+  size_t size;
+  size_t bytes;
+  uint32_t seq;
+  uint32_t pts;
+  uint32_t last_scr;
+  uint16_t last_sof;
+  struct timeval capture_time;
+  struct timeval arrival_time;
+  int64_t arrival_ns;
+  /** payload header bits seen in the frame, see uvc_stream_handle */
+  uint8_t info;
+  /** payload header extensions of the frame, see uvc_frame_t.metadata */
+  uint8_t meta[LIBUVC_METADATA_SIZE];
+  size_t meta_bytes;
+  /** enum uvc_frame_error bits found when the frame was completed */
+  uint8_t errors;
+  enum uvc_frame_slot_state state;
+};
+
 struct uvc_stream_handle {
   struct uvc_device_handle *devh;
   struct uvc_stream_handle *prev, *next;
@@ -1490,24 +1774,71 @@ struct uvc_stream_handle {
   /** Current control block */
   struct uvc_stream_ctrl cur_ctrl;
 
-  /* listeners may only access hold*, and only when holding a
-   * lock on cb_mutex (probably signaled with cb_cond) */
+  /* fid, seq, pts, last_scr, last_sof, got_bytes and fill_slot belong to the transfer
+   * callbacks. Listeners may only access the other slots, and only when
+   * holding a lock on cb_mutex (probably signaled with cb_cond) */
   uint8_t fid;
-  uint32_t seq, hold_seq;
-  uint32_t pts, hold_pts;
-  uint32_t last_scr, hold_last_scr;
-  size_t got_bytes, hold_bytes;
-  uint8_t *outbuf, *holdbuf;
+  uint32_t seq;
+  uint32_t pts;
+  uint32_t last_scr;
+  uint16_t last_sof;
+  size_t got_bytes;
+  /** set when the frame being assembled didn't fit into its slot */
+  uint8_t overflow;
+  /** enum uvc_frame_error bits of the frame being assembled */
+  uint8_t frame_errors;
+  /** payload header bits seen in the frame being assembled: PTS (1 << 2),
+   * SCR (1 << 3) */
+  uint8_t frame_info;
+  /** host monotonic time the current transfer completed, and the first
+   * payload of the frame being assembled arrived */
+  int64_t xfer_ns;
+  int64_t frame_start_ns;
+  /** host monotonic time the previous frame ended, 0 before the first */
+  int64_t last_eof_ns;
+  /** metadata gathered for the frame being assembled, and where its last
+   * entry starts */
+  size_t meta_bytes;
+  size_t meta_last;
+  /** metadata of frames copied out of their slot */
+  uint8_t frame_meta[LIBUVC_METADATA_SIZE];
+  struct uvc_clock clock;
+  struct uvc_frame_slot *slots;
+  int num_slots;
+  struct uvc_frame_slot *fill_slot;
+  uvc_stream_stats_t stats;
   pthread_mutex_t cb_mutex;
   pthread_cond_t cb_cond;
   pthread_t cb_thread;
-  uint32_t last_polled_seq;
   uvc_frame_callback_t *user_cb;
   void *user_ptr;
+  /** Stream setup flags (enum uvc_stream_flags) */
+  uint8_t flags;
+  /** Transfers and iso packets per transfer asked for, 0 picks a default */
+  int req_transfers;
+  int req_packets;
+  /** Transfers set up by uvc_stream_start */
+  int num_transfers;
+  int packets_per_transfer;
+  size_t transfer_size;
+  /** Transfers whose buffer came from libusb_dev_mem_alloc */
+  int dev_mem_transfers;
   struct libusb_transfer *transfers[LIBUVC_NUM_TRANSFER_BUFS];
   uint8_t *transfer_bufs[LIBUVC_NUM_TRANSFER_BUFS];
+  uint8_t transfer_dev_mem[LIBUVC_NUM_TRANSFER_BUFS];
+  /** UVC_STREAM_FLAG_DIRECT_BULK is in effect: the expected payload header
+   * length, where the transfer was submitted and the frame data under its
+   * header */
+  uint8_t direct;
+  size_t direct_hdr;
+  uint8_t *direct_dst;
+  uint8_t direct_stash[LIBUVC_SLOT_HEADROOM];
   struct uvc_frame frame;
+  /** Frame layout of the running stream, resolved by uvc_stream_start */
   enum uvc_frame_format frame_format;
+  uint32_t width;
+  uint32_t height;
+  size_t step;
 };
 
 /** Handle on an open UVC device
@@ -6099,7 +6430,7 @@ uvc_frame_desc_t *uvc_find_frame_desc_stream(uvc_stream_handle_t *strmh,
 uvc_frame_desc_t *uvc_find_frame_desc(uvc_device_handle_t *devh,
     uint16_t format_id, uint16_t frame_id);
 void *_uvc_user_caller(void *arg);
-void _uvc_populate_frame(uvc_stream_handle_t *strmh);
+void _uvc_populate_frame(uvc_stream_handle_t *strmh, struct uvc_frame_slot *slot);
 
 struct format_table_entry {
   enum uvc_frame_format format;
@@ -6477,31 +6808,499 @@ uvc_error_t uvc_probe_stream_ctrl(
 }
 
 /** @internal
- * @brief Swap the working buffer with the presented buffer and notify consumers
+ * @brief Find a slot the transfer callbacks can fill next
+ * must be called with stream cb lock held!
+ *
+ * Prefers a free slot. If there is none, the oldest frame nobody has picked
+ * up yet is dropped to make room. Returns NULL if every slot is lent out.
+ */
+static struct uvc_frame_slot *_uvc_claim_slot(uvc_stream_handle_t *strmh) {
+  struct uvc_frame_slot *slot, *oldest = NULL;
+  int i;
+
+  for (i = 0; i < strmh->num_slots; i++) {
+    slot = &strmh->slots[i];
+
+    if (slot->state == UVC_FRAME_SLOT_FREE)
+      return slot;
+
+    if (slot->state == UVC_FRAME_SLOT_READY && (!oldest || slot->seq < oldest->seq))
+      oldest = slot;
+  }
+
+  if (oldest) {
+    UVC_DEBUG("no free frame slot, dropping frame %d", oldest->seq);
+    strmh->stats.dropped_frames++;
+  }
+
+  return oldest;
+}
+
+/** @internal
+ * @brief Find the oldest completed frame that hasn't been handed out yet
+ * must be called with stream cb lock held!
+ */
+static struct uvc_frame_slot *_uvc_next_ready_slot(uvc_stream_handle_t *strmh) {
+  struct uvc_frame_slot *slot, *oldest = NULL;
+  int i;
+
+  for (i = 0; i < strmh->num_slots; i++) {
+    slot = &strmh->slots[i];
+
+    if (slot->state == UVC_FRAME_SLOT_READY && (!oldest || slot->seq < oldest->seq))
+      oldest = slot;
+  }
+
+  return oldest;
+}
+
+/** @internal
+ * @brief Frame slot size for the stream's current control block
+ */
+static size_t _uvc_slot_size(uvc_stream_handle_t *strmh) {
+  size_t size = strmh->cur_ctrl.dwMaxVideoFrameSize;
+
+  if (size == 0 || size > LIBUVC_MAX_FRAME_SIZE)
+    size = LIBUVC_XFER_BUF_SIZE;
+
+  return size;
+}
+
+/** @internal
+ * @brief Make a frame slot hold at least size bytes, keeping its contents
+ */
+static uvc_error_t _uvc_resize_slot(struct uvc_frame_slot *slot, size_t size) {
+  uint8_t *mem;
+
+  if (slot->mem && slot->size >= size)
+    return UVC_SUCCESS;
+
+  mem = realloc(slot->mem, LIBUVC_SLOT_HEADROOM + size);
+  if (!mem)
+    return UVC_ERROR_NO_MEM;
+
+  slot->mem = mem;
+  slot->buf = mem + LIBUVC_SLOT_HEADROOM;
+  slot->size = size;
+  return UVC_SUCCESS;
+}
+
+/** @internal
+ * @brief Make room for len more bytes in the slot being filled
+ *
+ * Grows the slot by at least half its size if the device sends more than
+ * it announced, up to LIBUVC_MAX_FRAME_SIZE.
+ */
+static uvc_error_t _uvc_reserve_fill(uvc_stream_handle_t *strmh, size_t len) {
+  struct uvc_frame_slot *fill = strmh->fill_slot;
+  size_t need = strmh->got_bytes + len;
+  size_t size;
+
+  if (need <= fill->size)
+    return UVC_SUCCESS;
+
+  if (need > LIBUVC_MAX_FRAME_SIZE)
+    return UVC_ERROR_OVERFLOW;
+
+  size = fill->size + fill->size / 2;
+  if (size < need)
+    size = need;
+  if (size > LIBUVC_MAX_FRAME_SIZE)
+    size = LIBUVC_MAX_FRAME_SIZE;
+
+  UVC_DEBUG("frame %d overruns its %zu byte slot, growing to %zu", strmh->seq, fill->size, size);
+
+  /* only the transfer callbacks touch the filling slot's buffer */
+  if (_uvc_resize_slot(fill, size) != UVC_SUCCESS)
+    return UVC_ERROR_NO_MEM;
+
+  pthread_mutex_lock(&strmh->cb_mutex);
+  strmh->stats.grown_slots++;
+  pthread_mutex_unlock(&strmh->cb_mutex);
+
+  return UVC_SUCCESS;
+}
+
+/* How long the running minimums of the clock recovery remember a value, and
+ * the longest gap between SCRs it bridges */
+#define LIBUVC_CLOCK_WINDOW_NS 1000000000
+
+/** @internal
+ * @brief Host monotonic time in ns
+ */
+static int64_t _uvc_monotonic_ns(void) {
+#if _POSIX_TIMERS > 0
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#else
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return (int64_t) tv.tv_sec * 1000000000 + (int64_t) tv.tv_usec * 1000;
+#endif
+}
+
+/** @internal
+ * @brief Device clock ticks to ns, without overflowing for large tick counts
+ */
+static int64_t _uvc_ticks_to_ns(int64_t ticks, uint32_t freq) {
+  return ticks / freq * 1000000000 + ticks % freq * 1000000000 / freq;
+}
+
+static void _uvc_clock_min_reset(struct uvc_clock_min *m) {
+  m->cur = INT64_MAX;
+  m->prev = INT64_MAX;
+  m->start_ns = INT64_MIN / 2;
+}
+
+static void _uvc_clock_min_add(struct uvc_clock_min *m, int64_t value, int64_t now_ns) {
+  if (now_ns - m->start_ns >= LIBUVC_CLOCK_WINDOW_NS) {
+    m->prev = m->cur;
+    m->cur = value;
+    m->start_ns = now_ns;
+  } else if (value < m->cur) {
+    m->cur = value;
+  }
+}
+
+static int64_t _uvc_clock_min_get(struct uvc_clock_min *m) {
+  return m->cur < m->prev ? m->cur : m->prev;
+}
+
+/** @internal
+ * @brief Forget everything the clock recovery learned
+ */
+static void _uvc_clock_reset(struct uvc_clock *clock, uint32_t freq) {
+  memset(clock, 0, sizeof(*clock));
+  clock->freq = freq;
+  _uvc_clock_min_reset(&clock->sof_offset);
+  _uvc_clock_min_reset(&clock->stc_offset);
+}
+
+/** @internal
+ * @brief Feed the SCR of a payload to the clock recovery
+ *
+ * @param stc Device clock when the payload was sent
+ * @param sof USB SOF counter when the STC was sampled
+ * @param host_ns Host monotonic time the payload arrived
+ */
+static void _uvc_clock_add_scr(struct uvc_clock *clock, uint32_t stc, uint16_t sof, int64_t host_ns) {
+  sof &= 0x7ff;
+
+  /* past a long gap it can't be told how often the counters wrapped */
+  if (clock->valid && host_ns - clock->host_ns > LIBUVC_CLOCK_WINDOW_NS)
+    _uvc_clock_reset(clock, clock->freq);
+
+  if (!clock->valid) {
+    clock->stc = stc;
+    clock->sof = sof;
+    clock->valid = 1;
+  } else {
+    clock->stc += (uint32_t) (stc - clock->stc_raw);
+    /* the 11 bit SOF counter wraps every 2048 ms */
+    clock->sof += (sof - clock->sof_raw) & 0x7ff;
+  }
+
+  clock->stc_raw = stc;
+  clock->sof_raw = sof;
+  clock->host_ns = host_ns;
+
+  _uvc_clock_min_add(&clock->sof_offset, host_ns - clock->sof * 1000000, host_ns);
+  if (clock->freq)
+    _uvc_clock_min_add(&clock->stc_offset, host_ns - _uvc_ticks_to_ns(clock->stc, clock->freq), host_ns);
+}
+
+/** @internal
+ * @brief Add the latest SCR to the samples of the STC to SOF fit
+ */
+static void _uvc_clock_add_sample(struct uvc_clock *clock) {
+  clock->sample_stc[clock->head] = clock->stc;
+  clock->sample_sof[clock->head] = clock->sof;
+  clock->head = (clock->head + 1) % LIBUVC_CLOCK_SAMPLES;
+  if (clock->count < LIBUVC_CLOCK_SAMPLES)
+    clock->count++;
+}
+
+/** @internal
+ * @brief Least squares fit of SOF (ms) over STC (ticks), both relative to
+ * the latest SCR
+ *
+ * @return 0 if the fit is usable: enough samples spanning at least 100 ms,
+ * with a slope within 2% of what dwClockFrequency says. Devices that don't
+ * fill in the SOF counter fail this.
+ */
+static int _uvc_clock_fit(struct uvc_clock *clock, double *slope, double *intercept) {
+  double sx = 0, sy = 0, sxx = 0, sxy = 0, x, y, n = clock->count, d;
+  int64_t sof_min = INT64_MAX, sof_max = INT64_MIN;
+  int i;
+
+  if (clock->count < 8)
+    return -1;
+
+  for (i = 0; i < clock->count; i++) {
+    x = (double) (clock->sample_stc[i] - clock->stc);
+    y = (double) (clock->sample_sof[i] - clock->sof);
+    sx += x;
+    sy += y;
+    sxx += x * x;
+    sxy += x * y;
+    if (clock->sample_sof[i] < sof_min)
+      sof_min = clock->sample_sof[i];
+    if (clock->sample_sof[i] > sof_max)
+      sof_max = clock->sample_sof[i];
+  }
+
+  if (sof_max - sof_min < 100)
+    return -1;
+
+  d = n * sxx - sx * sx;
+  if (d <= 0)
+    return -1;
+
+  *slope = (n * sxy - sx * sy) / d;
+  *intercept = (sy - *slope * sx) / n;
+
+  /* ms per tick against the nominal 1000 / freq */
+  d = *slope * clock->freq / 1000.0;
+  if (d < 0.98 || d > 1.02)
+    return -1;
+
+  return 0;
+}
+
+/** @internal
+ * @brief Map a device clock PTS to host monotonic time
+ *
+ * Through the SOF fit where the device supports it: the SOF counter only
+ * counts whole milliseconds, so the STC is sampled on average half a
+ * millisecond into the SOF it reports. Otherwise along the STC offset,
+ * which is at the mercy of dwClockFrequency's accuracy.
+ *
+ * @return 0 on success, -1 if the clock recovery has no SCR yet
+ */
+static int _uvc_clock_to_host(struct uvc_clock *clock, uint32_t pts, int64_t *host_ns) {
+  /* capture starts shortly before the latest SCR, far less than half a wrap */
+  int64_t ticks = (int32_t) (pts - clock->stc_raw);
+  double slope, intercept, ms;
+
+  if (!clock->valid || !clock->freq)
+    return -1;
+
+  if (_uvc_clock_fit(clock, &slope, &intercept) == 0) {
+    ms = intercept + slope * ticks + 0.5;
+    *host_ns = _uvc_clock_min_get(&clock->sof_offset) + clock->sof * 1000000 + (int64_t) (ms * 1e6);
+    return 0;
+  }
+
+  *host_ns = _uvc_clock_min_get(&clock->stc_offset) + _uvc_ticks_to_ns(clock->stc + ticks, clock->freq);
+  return 0;
+}
+
+/** @internal
+ * @brief Estimate when the device started capturing the frame being
+ * assembled, in host monotonic time
+ *
+ * Uses the PTS where the device sends one and SCRs to map it. Falls back to
+ * the arrival of the frame's first payload.
+ */
+static int64_t _uvc_capture_ns(uvc_stream_handle_t *strmh) {
+  int64_t capture_ns = strmh->frame_start_ns;
+
+  if (strmh->frame_info & (1 << 3))
+    _uvc_clock_add_sample(&strmh->clock);
+
+  if (strmh->frame_info & (1 << 2))
+    _uvc_clock_to_host(&strmh->clock, strmh->pts, &capture_ns);
+
+  return capture_ns;
+}
+
+/** @internal
+ * @brief Wall clock time minus host monotonic time, in ns
+ */
+static int64_t _uvc_wall_offset_ns(void) {
+  struct timeval now;
+
+  gettimeofday(&now, NULL);
+  return (int64_t) now.tv_sec * 1000000000 + (int64_t) now.tv_usec * 1000 - _uvc_monotonic_ns();
+}
+
+static void _uvc_monotonic_to_timeval(int64_t ns, int64_t wall_offset_ns, struct timeval *tv) {
+  int64_t wall_us = (ns + wall_offset_ns) / 1000;
+
+  tv->tv_sec = wall_us / 1000000;
+  tv->tv_usec = wall_us % 1000000;
+}
+
+/** @internal
+ * @brief Bucket of a duration in a uvc_histogram_t
+ */
+static int _uvc_hist_bucket(uint64_t us) {
+  int e = 0;
+  int bucket;
+
+  if (us < 8)
+    return (int) us;
+
+  while (us >> (e + 1))
+    e++;
+
+  bucket = (e - 2) * 8 + (int) ((us >> (e - 3)) & 7);
+  return bucket < UVC_HIST_BUCKETS ? bucket : UVC_HIST_BUCKETS - 1;
+}
+
+static void _uvc_hist_add(uvc_histogram_t *hist, uint64_t us) {
+  if (us > UINT32_MAX)
+    us = UINT32_MAX;
+
+  hist->buckets[_uvc_hist_bucket(us)]++;
+  if (hist->count == 0 || us < hist->min_us)
+    hist->min_us = us;
+  if (us > hist->max_us)
+    hist->max_us = us;
+  hist->count++;
+  hist->sum_us += us;
+}
+
+/** @internal
+ * @brief Cheap structural checks of an assembled MJPEG frame
+ *
+ * Only looks at both ends of the frame, the entropy coded data is left to
+ * the decoder. Any frame needs at least two bits per 8x8 block (DC size and
+ * end of block), half of that is taken as the lower bound.
+ *
+ * @return enum uvc_frame_error bits
+ */
+static uint8_t _uvc_check_mjpeg(uvc_stream_handle_t *strmh, const uint8_t *data, size_t bytes) {
+  uint8_t errors = 0;
+  size_t min_bytes = 128 + (size_t) strmh->width * strmh->height / 512;
+  size_t end = bytes;
+
+  if (bytes < min_bytes)
+    errors |= UVC_FRAME_ERROR_SIZE;
+
+  if (bytes < 2 || data[0] != 0xff || data[1] != 0xd8)
+    errors |= UVC_FRAME_ERROR_NO_SOI;
+
+  /* some devices pad the frame with zeros after the EOI marker */
+  while (end > 2 && data[end - 1] == 0)
+    end--;
+
+  if (end < 4 || data[end - 2] != 0xff || data[end - 1] != 0xd9)
+    errors |= UVC_FRAME_ERROR_NO_EOI;
+
+  return errors;
+}
+
+/** @internal
+ * @brief Publish the slot being filled and notify consumers
  */
 void _uvc_swap_buffers(uvc_stream_handle_t *strmh) {
-  uint8_t *tmp_buf;
+  struct uvc_frame_slot *fill = strmh->fill_slot;
+  struct uvc_frame_slot *next;
+  struct timeval capture_time, arrival_time;
+  int64_t wall_offset_ns = _uvc_wall_offset_ns();
+  int64_t interval_ns = 0;
+  uint8_t errors = 0;
+
+  _uvc_monotonic_to_timeval(_uvc_capture_ns(strmh), wall_offset_ns, &capture_time);
+  /* the EOF arrived with the current transfer */
+  _uvc_monotonic_to_timeval(strmh->xfer_ns, wall_offset_ns, &arrival_time);
+  if (strmh->last_eof_ns)
+    interval_ns = strmh->xfer_ns - strmh->last_eof_ns;
+  strmh->last_eof_ns = strmh->xfer_ns;
+
+  /* the filling slot belongs to the transfer callbacks, check it unlocked */
+  if ((strmh->flags & UVC_STREAM_FLAG_VALIDATE) && !strmh->overflow) {
+    errors = strmh->frame_errors;
+    if (strmh->frame_format == UVC_FRAME_FORMAT_MJPEG)
+      errors |= _uvc_check_mjpeg(strmh, fill->buf, strmh->got_bytes);
+  }
 
   pthread_mutex_lock(&strmh->cb_mutex);
 
-  /* swap the buffers */
-  tmp_buf = strmh->holdbuf;
-  strmh->hold_bytes = strmh->got_bytes;
-  strmh->holdbuf = strmh->outbuf;
-  strmh->outbuf = tmp_buf;
-  strmh->hold_last_scr = strmh->last_scr;
-  strmh->hold_pts = strmh->pts;
-  strmh->hold_seq = strmh->seq;
+  strmh->stats.frames++;
+
+  if (interval_ns > 0) {
+    _uvc_hist_add(&strmh->stats.frame_intervals, interval_ns / 1000);
+    /* dwFrameInterval is in 100 ns units */
+    if (strmh->cur_ctrl.dwFrameInterval &&
+        interval_ns * 2 > (int64_t) strmh->cur_ctrl.dwFrameInterval * 300)
+      strmh->stats.late_frames++;
+  }
+
+  if (strmh->overflow) {
+    /* Truncated frame, reuse the slot for the next one */
+    UVC_DEBUG("frame %d overflowed its slot, dropping it", strmh->seq);
+    strmh->stats.overflowed_frames++;
+    pthread_mutex_unlock(&strmh->cb_mutex);
+    goto reset;
+  }
+
+  if (errors) {
+    if (errors & UVC_FRAME_ERROR_PAYLOAD)
+      strmh->stats.payload_errors++;
+    if (errors & UVC_FRAME_ERROR_NO_SOI)
+      strmh->stats.missing_soi++;
+    if (errors & UVC_FRAME_ERROR_NO_EOI)
+      strmh->stats.missing_eoi++;
+    if (errors & UVC_FRAME_ERROR_SIZE)
+      strmh->stats.bad_size++;
+
+    if (!(strmh->flags & UVC_STREAM_FLAG_KEEP_CORRUPT)) {
+      /* Corrupt frame, reuse the slot for the next one */
+      UVC_DEBUG("frame %d is corrupt (0x%x), dropping it", strmh->seq, errors);
+      strmh->stats.corrupt_frames++;
+      pthread_mutex_unlock(&strmh->cb_mutex);
+      goto reset;
+    }
+  }
+
+  fill->state = UVC_FRAME_SLOT_READY;
+  fill->errors = errors;
+  fill->bytes = strmh->got_bytes;
+  fill->last_scr = strmh->last_scr;
+  fill->last_sof = strmh->last_sof;
+  fill->pts = strmh->pts;
+  fill->info = strmh->frame_info;
+  fill->meta_bytes = strmh->meta_bytes;
+  fill->capture_time = capture_time;
+  fill->arrival_time = arrival_time;
+  fill->arrival_ns = strmh->xfer_ns;
+  fill->seq = strmh->seq;
+
+  next = _uvc_claim_slot(strmh);
+  if (next) {
+    next->state = UVC_FRAME_SLOT_FILLING;
+    strmh->fill_slot = next;
+    pthread_cond_broadcast(&strmh->cb_cond);
+  } else {
+    /* The consumer holds every other slot; there is nowhere to put the
+     * next frame, so drop this one and keep filling its slot. */
+    UVC_DEBUG("all frame slots lent, dropping frame %d", strmh->seq);
+    fill->state = UVC_FRAME_SLOT_FILLING;
+    strmh->stats.dropped_frames++;
+  }
 
-  pthread_cond_broadcast(&strmh->cb_cond);
   pthread_mutex_unlock(&strmh->cb_mutex);
 
+reset:
   strmh->seq++;
   strmh->got_bytes = 0;
+  strmh->overflow = 0;
+  strmh->frame_errors = 0;
+  strmh->frame_info = 0;
+  strmh->meta_bytes = 0;
   strmh->last_scr = 0;
+  strmh->last_sof = 0;
   strmh->pts = 0;
 }
 
+static void _uvc_process_payload_data(uvc_stream_handle_t *strmh, uint8_t *header, size_t header_len,
+    uint8_t *data, size_t data_len);
+
 /** @internal
  * @brief Process a payload transfer
  * 
@@ -6514,7 +7313,6 @@ void _uvc_swap_buffers(uvc_stream_handle_t *strmh) {
  */
 void _uvc_process_payload(uvc_stream_handle_t *strmh, uint8_t *payload, size_t payload_len) {
   size_t header_len;
-  uint8_t header_info;
   size_t data_len;
 
   /* magic numbers for identifying header packets from some iSight cameras */
@@ -6555,18 +7353,52 @@ void _uvc_process_payload(uvc_stream_handle_t *strmh, uint8_t *payload, size_t p
       data_len = payload_len - header_len;
   }
 
+  _uvc_process_payload_data(strmh, payload, header_len, payload + header_len, data_len);
+}
+
+/** @internal
+ * @brief Keep the payload header bytes past the standard fields
+ *
+ * Devices usually repeat the same extension in every payload of a frame,
+ * so it's only kept if it differs from the previous one.
+ */
+static void _uvc_add_metadata(uvc_stream_handle_t *strmh, const uint8_t *ext, size_t len) {
+  uint8_t *meta = strmh->fill_slot->meta;
+
+  if (strmh->meta_bytes > 0 && meta[strmh->meta_last] == len &&
+      !memcmp(meta + strmh->meta_last + 1, ext, len))
+    return;
+
+  if (strmh->meta_bytes + 1 + len > LIBUVC_METADATA_SIZE)
+    return;
+
+  strmh->meta_last = strmh->meta_bytes;
+  meta[strmh->meta_bytes] = len;
+  memcpy(meta + strmh->meta_bytes + 1, ext, len);
+  strmh->meta_bytes += 1 + len;
+}
+
+/** @internal
+ * @brief Process the header and image data of a payload transfer
+ *
+ * @param header Payload header
+ * @param header_len Length of the payload header
+ * @param data Image data. May already sit at the write offset of the slot
+ * being filled (direct bulk transfers), and is moved otherwise.
+ * @param data_len Length of the image data
+ */
+static void _uvc_process_payload_data(uvc_stream_handle_t *strmh, uint8_t *header, size_t header_len,
+    uint8_t *data, size_t data_len) {
+  uint8_t header_info;
+  uint8_t *dst;
+
   if (header_len < 2) {
     header_info = 0;
   } else {
     /** @todo we should be checking the end-of-header bit */
     size_t variable_offset = 2;
 
-    header_info = payload[1];
-
-    if (header_info & 0x40) {
-      UVC_DEBUG("bad packet: error bit set");
-      return;
-    }
+    header_info = header[1];
 
     if (strmh->fid != (header_info & 1) && strmh->got_bytes != 0) {
       /* The frame ID bit was flipped, but we have image data sitting
@@ -6577,21 +7409,44 @@ void _uvc_process_payload(uvc_stream_handle_t *strmh, uint8_t *payload, size_t p
 
     strmh->fid = header_info & 1;
 
+    if (header_info & 0x40) {
+      /* charge the lost data to the frame it belongs to */
+      UVC_DEBUG("bad packet: error bit set");
+      strmh->frame_errors |= UVC_FRAME_ERROR_PAYLOAD;
+      return;
+    }
+
     if (header_info & (1 << 2)) {
-      strmh->pts = DW_TO_INT(payload + variable_offset);
+      strmh->pts = DW_TO_INT(header + variable_offset);
       variable_offset += 4;
     }
 
     if (header_info & (1 << 3)) {
-      /** @todo read the SOF token counter */
-      strmh->last_scr = DW_TO_INT(payload + variable_offset);
+      strmh->last_scr = DW_TO_INT(header + variable_offset);
+      strmh->last_sof = SW_TO_SHORT(header + variable_offset + 4) & 0x7ff;
+      _uvc_clock_add_scr(&strmh->clock, strmh->last_scr, strmh->last_sof, strmh->xfer_ns);
       variable_offset += 6;
     }
+
+    strmh->frame_info |= header_info & ((1 << 2) | (1 << 3));
+
+    if (header_len > variable_offset)
+      _uvc_add_metadata(strmh, header + variable_offset, header_len - variable_offset);
   }
 
   if (data_len > 0) {
-    memcpy(strmh->outbuf + strmh->got_bytes, payload + header_len, data_len);
-    strmh->got_bytes += data_len;
+    if (strmh->got_bytes == 0)
+      strmh->frame_start_ns = strmh->xfer_ns;
+
+    if (!strmh->overflow && _uvc_reserve_fill(strmh, data_len) != UVC_SUCCESS)
+      strmh->overflow = 1;
+
+    if (!strmh->overflow) {
+      dst = strmh->fill_slot->buf + strmh->got_bytes;
+      if (data != dst)
+        memmove(dst, data, data_len);
+      strmh->got_bytes += data_len;
+    }
 
     if (header_info & (1 << 1)) {
       /* The EOF bit is set, so publish the complete frame */
@@ -6601,21 +7456,147 @@ void _uvc_process_payload(uvc_stream_handle_t *strmh, uint8_t *payload, size_t p
 }
 
 /** @internal
- * @brief Stream transfer callback
- *
- * Processes stream, places frames into buffer, signals listeners
- * (such as user callback thread and any polling thread) on new frame
+ * @brief Submit the direct bulk transfer at the write offset of the slot
+ * being filled
  *
- * @param transfer Active transfer
+ * The transfer starts direct_hdr bytes before the offset, where the payload
+ * header is expected to land; the frame data it overwrites there is stashed
+ * and put back on completion.
  */
-void LIBUSB_CALL _uvc_stream_callback(struct libusb_transfer *transfer) {
-  uvc_stream_handle_t *strmh = transfer->user_data;
+static int _uvc_submit_direct(uvc_stream_handle_t *strmh, struct libusb_transfer *transfer) {
+  struct uvc_frame_slot *fill = strmh->fill_slot;
+  size_t offset;
 
-  int resubmit = 1;
+  if (!strmh->overflow &&
+      _uvc_reserve_fill(strmh, strmh->transfer_size) != UVC_SUCCESS)
+    strmh->overflow = 1;
+
+  /* an overflowing frame is discarded, keep receiving to find its end */
+  offset = strmh->overflow ? 0 : strmh->got_bytes;
+
+  strmh->direct_dst = fill->buf + offset - strmh->direct_hdr;
+  memcpy(strmh->direct_stash, strmh->direct_dst, strmh->direct_hdr);
+
+  transfer->buffer = strmh->direct_dst;
+  transfer->length = strmh->transfer_size;
+
+  return libusb_submit_transfer(transfer);
+}
+
+/** @internal
+ * @brief Put back the frame data under the direct transfer's header
+ */
+static void _uvc_restore_direct(uvc_stream_handle_t *strmh) {
+  memcpy(strmh->direct_dst, strmh->direct_stash, strmh->direct_hdr);
+}
+
+/** @internal
+ * @brief Process a completed direct bulk transfer
+ *
+ * The image data normally sits right at the write offset already. Only if
+ * the header length changed does it have to be moved once.
+ */
+static void _uvc_process_direct(uvc_stream_handle_t *strmh, struct libusb_transfer *transfer) {
+  uint8_t header[LIBUVC_SLOT_HEADROOM];
+  uint8_t *payload = transfer->buffer;
+  size_t payload_len = transfer->actual_length;
+  size_t header_len, data_len;
+  size_t expected = strmh->direct_hdr;
+
+  if (payload_len == 0) {
+    _uvc_restore_direct(strmh);
+    return;
+  }
+
+  header_len = payload[0];
+  if (header_len > payload_len) {
+    UVC_DEBUG("bogus packet: actual_len=%zd, header_len=%zd\n", payload_len, header_len);
+    _uvc_restore_direct(strmh);
+    return;
+  }
+  data_len = payload_len - header_len;
+
+  memcpy(header, payload, header_len);
+
+  /* shift the image data to where the header was expected to end */
+  if (header_len != expected)
+    memmove(payload + expected, payload + header_len, data_len);
+  _uvc_restore_direct(strmh);
+
+  /* and expect the next header to be as long as this one */
+  if (header_len > 0)
+    strmh->direct_hdr = header_len;
+
+  _uvc_process_payload_data(strmh, header, header_len, payload + expected, data_len);
+}
+
+/** @internal
+ * @brief Allocate the buffer of transfer i
+ *
+ * Prefers memory that libusb maps for DMA (usbfs zero-copy on Linux), so the
+ * kernel doesn't have to bounce every URB through a copy. Falls back to
+ * malloc where that isn't available.
+ */
+static uint8_t *_uvc_alloc_transfer_buf(uvc_stream_handle_t *strmh, int i, size_t size) {
+  strmh->transfer_dev_mem[i] = 0;
+
+#if LIBUSB_API_VERSION >= 0x01000105
+  strmh->transfer_bufs[i] = libusb_dev_mem_alloc(strmh->devh->usb_devh, size);
+  if (strmh->transfer_bufs[i]) {
+    strmh->transfer_dev_mem[i] = 1;
+    strmh->dev_mem_transfers++;
+    return strmh->transfer_bufs[i];
+  }
+#endif
+
+  strmh->transfer_bufs[i] = malloc(size);
+  return strmh->transfer_bufs[i];
+}
+
+/** @internal
+ * @brief Free transfer i along with its buffer
+ */
+static void _uvc_free_transfer(uvc_stream_handle_t *strmh, int i) {
+  struct libusb_transfer *transfer = strmh->transfers[i];
+
+  /* direct bulk transfers point into a frame slot and own no buffer */
+#if LIBUSB_API_VERSION >= 0x01000105
+  if (strmh->transfer_dev_mem[i])
+    libusb_dev_mem_free(strmh->devh->usb_devh, strmh->transfer_bufs[i], strmh->transfer_size);
+  else
+#endif
+    free(strmh->transfer_bufs[i]);
+
+  libusb_free_transfer(transfer);
+  strmh->transfers[i] = NULL;
+  strmh->transfer_bufs[i] = NULL;
+}
+
+/** @internal
+ * @brief Stream transfer callback
+ *
+ * Processes stream, places frames into buffer, signals listeners
+ * (such as user callback thread and any polling thread) on new frame
+ *
+ * @param transfer Active transfer
+ */
+void LIBUSB_CALL _uvc_stream_callback(struct libusb_transfer *transfer) {
+  uvc_stream_handle_t *strmh = transfer->user_data;
+
+  int resubmit = 1;
+
+  /* whatever partially arrived, the stashed frame data goes back */
+  if (strmh->direct && transfer->status != LIBUSB_TRANSFER_COMPLETED)
+    _uvc_restore_direct(strmh);
 
   switch (transfer->status) {
   case LIBUSB_TRANSFER_COMPLETED:
-    if (transfer->num_iso_packets == 0) {
+    /* every payload of the transfer arrived by now */
+    strmh->xfer_ns = _uvc_monotonic_ns();
+
+    if (strmh->direct) {
+      _uvc_process_direct(strmh, transfer);
+    } else if (transfer->num_iso_packets == 0) {
       /* This is a bulk mode transfer, so it just has one payload transfer */
       _uvc_process_payload(strmh, transfer->buffer, transfer->actual_length);
     } else {
@@ -6651,9 +7632,7 @@ void LIBUSB_CALL _uvc_stream_callback(struct libusb_transfer *transfer) {
     for(i=0; i < LIBUVC_NUM_TRANSFER_BUFS; i++) {
       if(strmh->transfers[i] == transfer) {
         UVC_DEBUG("Freeing transfer %d (%p)", i, transfer);
-        free(transfer->buffer);
-        libusb_free_transfer(transfer);
-        strmh->transfers[i] = NULL;
+        _uvc_free_transfer(strmh, i);
         break;
       }
     }
@@ -6677,7 +7656,10 @@ void LIBUSB_CALL _uvc_stream_callback(struct libusb_transfer *transfer) {
   
   if ( resubmit ) {
     if ( strmh->running ) {
-      libusb_submit_transfer(transfer);
+      if (strmh->direct)
+        _uvc_submit_direct(strmh, transfer);
+      else
+        libusb_submit_transfer(transfer);
     } else {
       int i;
       pthread_mutex_lock(&strmh->cb_mutex);
@@ -6686,9 +7668,7 @@ void LIBUSB_CALL _uvc_stream_callback(struct libusb_transfer *transfer) {
       for(i=0; i < LIBUVC_NUM_TRANSFER_BUFS; i++) {
         if(strmh->transfers[i] == transfer) {
           UVC_DEBUG("Freeing orphan transfer %d (%p)", i, transfer);
-          free(transfer->buffer);
-          libusb_free_transfer(transfer);
-          strmh->transfers[i] = NULL;
+          _uvc_free_transfer(strmh, i);
         }
       }
       if(i == LIBUVC_NUM_TRANSFER_BUFS ) {
@@ -6786,13 +7766,36 @@ static uvc_streaming_interface_t *_uvc_get_stream_if(uvc_device_handle_t *devh,
  *             {uvc_get_stream_ctrl_format_size}
  */
 uvc_error_t uvc_stream_open_ctrl(uvc_device_handle_t *devh, uvc_stream_handle_t **strmhp, uvc_stream_ctrl_t *ctrl) {
+  return uvc_stream_open_ctrl_slots(devh, strmhp, ctrl, LIBUVC_NUM_FRAME_SLOTS);
+}
+
+/** Open a new video stream with a ring of frame buffers.
+ * @ingroup streaming
+ *
+ * One slot is always being filled from the device. The remaining slots queue
+ * completed frames for the consumer, so a callback or poller that falls up to
+ * num_slots - 1 frames behind doesn't lose any.
+ *
+ * @param devh UVC device
+ * @param ctrl Control block, processed using {uvc_probe_stream_ctrl} or
+ *             {uvc_get_stream_ctrl_format_size}
+ * @param num_slots Number of frame buffers, at least 2
+ */
+uvc_error_t uvc_stream_open_ctrl_slots(uvc_device_handle_t *devh, uvc_stream_handle_t **strmhp, uvc_stream_ctrl_t *ctrl,
+    int num_slots) {
   /* Chosen frame and format descriptors */
   uvc_stream_handle_t *strmh = NULL;
   uvc_streaming_interface_t *stream_if;
   uvc_error_t ret;
+  int i;
 
   UVC_ENTER();
 
+  if (num_slots < 2 || num_slots > LIBUVC_MAX_FRAME_SLOTS) {
+    ret = UVC_ERROR_INVALID_PARAM;
+    goto fail;
+  }
+
   if (_uvc_get_stream_by_interface(devh, ctrl->bInterfaceNumber) != NULL) {
     ret = UVC_ERROR_BUSY; /* Stream is already opened */
     goto fail;
@@ -6823,10 +7826,19 @@ uvc_error_t uvc_stream_open_ctrl(uvc_device_handle_t *devh, uvc_stream_handle_t
 
   // Set up the streaming status and data space
   strmh->running = 0;
-  /** @todo take only what we need */
-  strmh->outbuf = malloc( LIBUVC_XFER_BUF_SIZE );
-  strmh->holdbuf = malloc( LIBUVC_XFER_BUF_SIZE );
-   
+  strmh->slots = calloc(num_slots, sizeof(*strmh->slots));
+  if (!strmh->slots) {
+    ret = UVC_ERROR_NO_MEM;
+    goto fail;
+  }
+  strmh->num_slots = num_slots;
+
+  for (i = 0; i < num_slots; i++) {
+    ret = _uvc_resize_slot(&strmh->slots[i], _uvc_slot_size(strmh));
+    if (ret != UVC_SUCCESS)
+      goto fail;
+  }
+
   pthread_mutex_init(&strmh->cb_mutex, NULL);
   pthread_cond_init(&strmh->cb_cond, NULL);
 
@@ -6838,19 +7850,119 @@ uvc_error_t uvc_stream_open_ctrl(uvc_device_handle_t *devh, uvc_stream_handle_t
   return UVC_SUCCESS;
 
 fail:
-  if(strmh)
+  if(strmh) {
+    if (strmh->slots) {
+      for (i = 0; i < strmh->num_slots; i++)
+        free(strmh->slots[i].mem);
+      free(strmh->slots);
+    }
     free(strmh);
+  }
   UVC_EXIT(ret);
   return ret;
 }
 
+/** @internal
+ * @brief Number of transfers to keep in flight
+ *
+ * Unless the user chose, queue enough to cover LIBUVC_TRANSFER_QUEUE_US or
+ * two frame intervals, whichever is longer.
+ * @param transfer_us Time the device takes to fill one transfer
+ */
+static int _uvc_transfer_count(uvc_stream_handle_t *strmh, uint64_t transfer_us) {
+  /* dwFrameInterval is in 100ns units */
+  uint64_t queue_us = (uint64_t) strmh->cur_ctrl.dwFrameInterval / 5;
+  uint64_t num;
+
+  if (strmh->req_transfers)
+    return strmh->req_transfers;
+
+  if (queue_us < LIBUVC_TRANSFER_QUEUE_US)
+    queue_us = LIBUVC_TRANSFER_QUEUE_US;
+  if (transfer_us == 0)
+    transfer_us = 1;
+
+  num = (queue_us + transfer_us - 1) / transfer_us;
+  if (num < LIBUVC_MIN_TRANSFER_BUFS)
+    num = LIBUVC_MIN_TRANSFER_BUFS;
+  if (num > LIBUVC_NUM_TRANSFER_BUFS)
+    num = LIBUVC_NUM_TRANSFER_BUFS;
+
+  return (int) num;
+}
+
+/** @internal
+ * @brief Time a bulk device takes to fill a transfer at the negotiated
+ * frame size and rate (30 fps and one transfer per frame if unknown)
+ */
+static uint64_t _uvc_bulk_transfer_us(uvc_stream_handle_t *strmh, size_t transfer_size) {
+  uint64_t interval = strmh->cur_ctrl.dwFrameInterval;
+  uint64_t frame_bytes = strmh->cur_ctrl.dwMaxVideoFrameSize;
+
+  if (interval == 0)
+    interval = 333333;
+  if (frame_bytes == 0)
+    frame_bytes = transfer_size;
+
+  return transfer_size * interval / (10 * frame_bytes);
+}
+
+/** Choose how many transfers to keep in flight and how many packets each
+ * isochronous transfer carries.
+ * @ingroup streaming
+ *
+ * Takes effect on the next uvc_stream_start. More, or larger, transfers
+ * ride out longer scheduling delays without dropping data, at the cost of
+ * memory pinned for in-flight transfers.
+ *
+ * @param strmh UVC stream
+ * @param num_transfers Number of transfers, up to LIBUVC_NUM_TRANSFER_BUFS.
+ *  0 picks enough to cover two frame intervals or LIBUVC_TRANSFER_QUEUE_US.
+ * @param packets_per_transfer Packets per isochronous transfer, up to
+ *  LIBUVC_MAX_ISO_PACKETS. 0 sizes transfers to a frame, at most
+ *  LIBUVC_ISO_PACKETS. Ignored for bulk streams, whose transfers are
+ *  dwMaxPayloadTransferSize long.
+ */
+uvc_error_t uvc_stream_set_transfers(uvc_stream_handle_t *strmh, int num_transfers, int packets_per_transfer) {
+  if (num_transfers < 0 || num_transfers > LIBUVC_NUM_TRANSFER_BUFS ||
+      packets_per_transfer < 0 || packets_per_transfer > LIBUVC_MAX_ISO_PACKETS)
+    return UVC_ERROR_INVALID_PARAM;
+
+  if (strmh->running)
+    return UVC_ERROR_BUSY;
+
+  strmh->req_transfers = num_transfers;
+  strmh->req_packets = packets_per_transfer;
+
+  return UVC_SUCCESS;
+}
+
+/** Get the transfers set up by the last uvc_stream_start
+ * @ingroup streaming
+ *
+ * @param[out] num_transfers Transfers kept in flight
+ * @param[out] packets_per_transfer Packets per isochronous transfer, 0 for bulk streams
+ * @param[out] transfer_size Bytes per transfer
+ * @param[out] dev_mem_transfers Transfers whose buffers libusb allocated for DMA
+ *  (usbfs zero-copy). The others are malloc'd and copied by the kernel.
+ */
+void uvc_stream_get_transfers(uvc_stream_handle_t *strmh, int *num_transfers, int *packets_per_transfer,
+    size_t *transfer_size, int *dev_mem_transfers) {
+  *num_transfers = strmh->num_transfers;
+  *packets_per_transfer = strmh->packets_per_transfer;
+  *transfer_size = strmh->transfer_size;
+  *dev_mem_transfers = strmh->dev_mem_transfers;
+}
+
 /** Begin streaming video from the stream into the callback function.
  * @ingroup streaming
  *
  * @param strmh UVC stream
  * @param cb   User callback function. See {uvc_frame_callback_t} for restrictions.
- * @param flags Stream setup flags, currently undefined. Set this to zero. The lower bit
+ * @param flags Stream setup flags (see {uvc_stream_flags}), or zero. The lower bit
  * is reserved for backward compatibility.
+ * @return UVC_ERROR_BUSY if the stream is running, or if a frame of a previous
+ * run is still lent (UVC_STREAM_FLAG_ZERO_COPY) and not yet released
  */
 uvc_error_t uvc_stream_start(
     uvc_stream_handle_t *strmh,
@@ -6870,6 +7982,7 @@ uvc_error_t uvc_stream_start(
   size_t total_transfer_size = 0;
   struct libusb_transfer *transfer;
   int transfer_id;
+  int slot_idx;
 
   ctrl = &strmh->cur_ctrl;
 
@@ -6880,11 +7993,39 @@ uvc_error_t uvc_stream_start(
     return UVC_ERROR_BUSY;
   }
 
+  /* lent slots may be resized below, and their buffers must stay valid
+   * until the consumer is done with them */
+  if (uvc_stream_lent_buffers(strmh) > 0) {
+    UVC_EXIT(UVC_ERROR_BUSY);
+    return UVC_ERROR_BUSY;
+  }
+
   strmh->running = 1;
+  strmh->flags = flags;
   strmh->seq = 1;
   strmh->fid = 0;
   strmh->pts = 0;
   strmh->last_scr = 0;
+  strmh->last_sof = 0;
+  strmh->got_bytes = 0;
+  strmh->overflow = 0;
+  strmh->frame_errors = 0;
+  strmh->frame_info = 0;
+  strmh->meta_bytes = 0;
+  strmh->last_eof_ns = 0;
+  _uvc_clock_reset(&strmh->clock, ctrl->dwClockFrequency);
+
+  /* frames left over from a previous run are gone (none is lent, see
+   * above); the control block may have been renegotiated since the slots
+   * were sized */
+  for (slot_idx = 0; slot_idx < strmh->num_slots; slot_idx++) {
+    strmh->slots[slot_idx].state = UVC_FRAME_SLOT_FREE;
+    ret = _uvc_resize_slot(&strmh->slots[slot_idx], _uvc_slot_size(strmh));
+    if (ret != UVC_SUCCESS)
+      goto fail;
+  }
+  strmh->fill_slot = &strmh->slots[0];
+  strmh->fill_slot->state = UVC_FRAME_SLOT_FILLING;
 
   frame_desc = uvc_find_frame_desc_stream(strmh, ctrl->bFormatIndex, ctrl->bFrameIndex);
   if (!frame_desc) {
@@ -6899,10 +8040,39 @@ uvc_error_t uvc_stream_start(
     goto fail;
   }
 
+  strmh->width = frame_desc->wWidth;
+  strmh->height = frame_desc->wHeight;
+
+  switch (strmh->frame_format) {
+  case UVC_FRAME_FORMAT_YUYV:
+  case UVC_FRAME_FORMAT_UYVY:
+  case UVC_FRAME_FORMAT_GRAY16:
+    strmh->step = strmh->width * 2;
+    break;
+  case UVC_FRAME_FORMAT_GRAY8:
+  case UVC_FRAME_FORMAT_BY8:
+  case UVC_FRAME_FORMAT_BA81:
+  case UVC_FRAME_FORMAT_SGRBG8:
+  case UVC_FRAME_FORMAT_SGBRG8:
+  case UVC_FRAME_FORMAT_SRGGB8:
+  case UVC_FRAME_FORMAT_SBGGR8:
+    strmh->step = strmh->width;
+    break;
+  case UVC_FRAME_FORMAT_MJPEG:
+    strmh->step = 0;
+    break;
+  default:
+    strmh->step = 0;
+    break;
+  }
+
   // Get the interface that provides the chosen format and frame configuration
   interface_id = strmh->stream_if->bInterfaceNumber;
   interface = &strmh->devh->info->config->interface[interface_id];
 
+  strmh->dev_mem_transfers = 0;
+  strmh->direct = 0;
+
   /* A VS interface uses isochronous transfers iff it has multiple altsettings.
    * (UVC 1.5: 2.4.3. VideoStreaming Interface) */
   isochronous = interface->num_altsetting > 1;
@@ -6917,6 +8087,9 @@ uvc_error_t uvc_stream_start(
     size_t config_bytes_per_packet;
     /* Number of packets per transfer */
     size_t packets_per_transfer = 0;
+    /* bInterval of the chosen endpoint, and microseconds between its packets */
+    uint8_t endpoint_interval = 0;
+    uint64_t packet_us;
     /* Size of packet transferable from the chosen endpoint */
     size_t endpoint_bytes_per_packet = 0;
     /* Index of the altsetting */
@@ -6930,6 +8103,7 @@ uvc_error_t uvc_stream_start(
     for (alt_idx = 0; alt_idx < interface->num_altsetting; alt_idx++) {
       altsetting = interface->altsetting + alt_idx;
       endpoint_bytes_per_packet = 0;
+      endpoint_interval = 0;
 
       /* Find the endpoint with the number specified in the VS header */
       for (ep_idx = 0; ep_idx < altsetting->bNumEndpoints; ep_idx++) {
@@ -6940,21 +8114,36 @@ uvc_error_t uvc_stream_start(
           // wMaxPacketSize: [unused:2 (multiplier-1):3 size:11]
           endpoint_bytes_per_packet = (endpoint_bytes_per_packet & 0x07ff) *
                                       (((endpoint_bytes_per_packet >> 11) & 3) + 1);
+          endpoint_interval = endpoint->bInterval;
           break;
         }
       }
 
       if (endpoint_bytes_per_packet >= config_bytes_per_packet) {
-        /* Transfers will be at most one frame long: Divide the maximum frame size
-         * by the size of the endpoint and round up */
-        packets_per_transfer = (ctrl->dwMaxVideoFrameSize +
-                                endpoint_bytes_per_packet - 1) / endpoint_bytes_per_packet;
-
-        /* But keep a reasonable limit: Otherwise we start dropping data */
-        if (packets_per_transfer > 32)
-          packets_per_transfer = 32;
-        
+        if (strmh->req_packets) {
+          packets_per_transfer = strmh->req_packets;
+        } else {
+          /* Transfers will be at most one frame long: Divide the maximum frame size
+           * by the size of the endpoint and round up */
+          packets_per_transfer = (ctrl->dwMaxVideoFrameSize +
+                                  endpoint_bytes_per_packet - 1) / endpoint_bytes_per_packet;
+
+          /* But keep a reasonable limit: Otherwise we start dropping data */
+          if (packets_per_transfer > LIBUVC_ISO_PACKETS)
+            packets_per_transfer = LIBUVC_ISO_PACKETS;
+          if (packets_per_transfer == 0)
+            packets_per_transfer = 1;
+        }
+
         total_transfer_size = packets_per_transfer * endpoint_bytes_per_packet;
+
+        /* (micro)frames of 125us from high speed on, with a service interval
+         * of 2^(bInterval-1) of them; full speed frames are 1ms */
+        if (libusb_get_device_speed(strmh->devh->dev->usb_dev) >= LIBUSB_SPEED_HIGH)
+          packet_us = 125 << (endpoint_interval > 1 ? (endpoint_interval - 1) & 15 : 0);
+        else
+          packet_us = 1000;
+        strmh->num_transfers = _uvc_transfer_count(strmh, packets_per_transfer * packet_us);
         break;
       }
     }
@@ -6975,10 +8164,10 @@ uvc_error_t uvc_stream_start(
     }
 
     /* Set up the transfers */
-    for (transfer_id = 0; transfer_id < LIBUVC_NUM_TRANSFER_BUFS; ++transfer_id) {
+    for (transfer_id = 0; transfer_id < strmh->num_transfers; ++transfer_id) {
       transfer = libusb_alloc_transfer(packets_per_transfer);
-      strmh->transfers[transfer_id] = transfer;      
-      strmh->transfer_bufs[transfer_id] = malloc(total_transfer_size);
+      strmh->transfers[transfer_id] = transfer;
+      _uvc_alloc_transfer_buf(strmh, transfer_id, total_transfer_size);
 
       libusb_fill_iso_transfer(
         transfer, strmh->devh->usb_devh, format_desc->parent->bEndpointAddress,
@@ -6987,13 +8176,42 @@ uvc_error_t uvc_stream_start(
 
       libusb_set_iso_packet_lengths(transfer, endpoint_bytes_per_packet);
     }
+    strmh->packets_per_transfer = packets_per_transfer;
+    strmh->transfer_size = total_transfer_size;
   } else {
-    for (transfer_id = 0; transfer_id < LIBUVC_NUM_TRANSFER_BUFS;
+    total_transfer_size = strmh->cur_ctrl.dwMaxPayloadTransferSize;
+    strmh->num_transfers = _uvc_transfer_count(strmh, _uvc_bulk_transfer_us(strmh, total_transfer_size));
+    strmh->packets_per_transfer = 0;
+    strmh->transfer_size = total_transfer_size;
+
+    if ((flags & UVC_STREAM_FLAG_DIRECT_BULK) && !strmh->devh->is_isight) {
+      /* One transfer, received into the frame slots, which need room for a
+       * whole transfer past the end of the largest frame */
+      for (slot_idx = 0; slot_idx < strmh->num_slots; slot_idx++) {
+        ret = _uvc_resize_slot(&strmh->slots[slot_idx], _uvc_slot_size(strmh) + total_transfer_size);
+        if (ret != UVC_SUCCESS)
+          goto fail;
+      }
+
+      transfer = libusb_alloc_transfer(0);
+      strmh->transfers[0] = transfer;
+      strmh->transfer_bufs[0] = NULL;
+      strmh->transfer_dev_mem[0] = 0;
+      libusb_fill_bulk_transfer ( transfer, strmh->devh->usb_devh,
+          format_desc->parent->bEndpointAddress,
+          NULL, 0, _uvc_stream_callback, ( void* ) strmh, 5000 );
+
+      strmh->num_transfers = 1;
+      strmh->direct = 1;
+      /* typical header: length, info, PTS and SCR */
+      strmh->direct_hdr = 12;
+    }
+
+    for (transfer_id = 0; !strmh->direct && transfer_id < strmh->num_transfers;
         ++transfer_id) {
       transfer = libusb_alloc_transfer(0);
       strmh->transfers[transfer_id] = transfer;
-      strmh->transfer_bufs[transfer_id] = malloc (
-          strmh->cur_ctrl.dwMaxPayloadTransferSize );
+      _uvc_alloc_transfer_buf(strmh, transfer_id, total_transfer_size);
       libusb_fill_bulk_transfer ( transfer, strmh->devh->usb_devh,
           format_desc->parent->bEndpointAddress,
           strmh->transfer_bufs[transfer_id],
@@ -7012,9 +8230,12 @@ uvc_error_t uvc_stream_start(
     pthread_create(&strmh->cb_thread, NULL, _uvc_user_caller, (void*) strmh);
   }
 
-  for (transfer_id = 0; transfer_id < LIBUVC_NUM_TRANSFER_BUFS;
+  for (transfer_id = 0; transfer_id < strmh->num_transfers;
       transfer_id++) {
-    ret = libusb_submit_transfer(strmh->transfers[transfer_id]);
+    if (strmh->direct)
+      ret = _uvc_submit_direct(strmh, strmh->transfers[transfer_id]);
+    else
+      ret = libusb_submit_transfer(strmh->transfers[transfer_id]);
     if (ret != UVC_SUCCESS) {
       UVC_DEBUG("libusb_submit_transfer failed: %d",ret);
       break;
@@ -7022,10 +8243,8 @@ uvc_error_t uvc_stream_start(
   }
 
   if ( ret != UVC_SUCCESS && transfer_id > 0 ) {
-    for ( ; transfer_id < LIBUVC_NUM_TRANSFER_BUFS; transfer_id++) {
-      free ( strmh->transfers[transfer_id]->buffer );
-      libusb_free_transfer ( strmh->transfers[transfer_id]);
-      strmh->transfers[transfer_id] = 0;
+    for ( ; transfer_id < strmh->num_transfers; transfer_id++) {
+      _uvc_free_transfer(strmh, transfer_id);
     }
     ret = UVC_SUCCESS;
   }
@@ -7064,13 +8283,12 @@ uvc_error_t uvc_stream_start_iso(
  */
 void *_uvc_user_caller(void *arg) {
   uvc_stream_handle_t *strmh = (uvc_stream_handle_t *) arg;
-
-  uint32_t last_seq = 0;
+  struct uvc_frame_slot *slot;
 
   do {
     pthread_mutex_lock(&strmh->cb_mutex);
 
-    while (strmh->running && last_seq == strmh->hold_seq) {
+    while (strmh->running && !(slot = _uvc_next_ready_slot(strmh))) {
       pthread_cond_wait(&strmh->cb_cond, &strmh->cb_mutex);
     }
 
@@ -7079,8 +8297,7 @@ void *_uvc_user_caller(void *arg) {
       break;
     }
     
-    last_seq = strmh->hold_seq;
-    _uvc_populate_frame(strmh);
+    _uvc_populate_frame(strmh, slot);
     
     pthread_mutex_unlock(&strmh->cb_mutex);
     
@@ -7093,49 +8310,150 @@ void *_uvc_user_caller(void *arg) {
 /** @internal
  * @brief Populate the fields of a frame to be handed to user code
  * must be called with stream cb lock held!
+ *
+ * The slot is lent out with the frame (UVC_STREAM_FLAG_ZERO_COPY) or copied
+ * and freed for the transfer callbacks to reuse.
  */
-void _uvc_populate_frame(uvc_stream_handle_t *strmh) {
+void _uvc_populate_frame(uvc_stream_handle_t *strmh, struct uvc_frame_slot *slot) {
   uvc_frame_t *frame = &strmh->frame;
-  uvc_frame_desc_t *frame_desc;
+  size_t need;
+  int dht;
 
-  /** @todo this stuff that hits the main config cache should really happen
-   * in start() so that only one thread hits these data. all of this stuff
-   * is going to be reopen_on_change anyway
-   */
+  /* resolved once by uvc_stream_start, the format can't change while running */
+  frame->frame_format = strmh->frame_format;
+  frame->width = strmh->width;
+  frame->height = strmh->height;
+  frame->step = strmh->step;
+
+  frame->sequence = slot->seq;
+  frame->errors = slot->errors;
+  frame->capture_time = slot->capture_time;
+  frame->arrival_time = slot->arrival_time;
+  frame->arrival_ns = slot->arrival_ns;
+  frame->has_pts = (slot->info & (1 << 2)) != 0;
+  frame->has_scr = (slot->info & (1 << 3)) != 0;
+  frame->pts = frame->has_pts ? slot->pts : 0;
+  frame->scr = frame->has_scr ? slot->last_scr : 0;
+  frame->sof = frame->has_scr ? slot->last_sof : 0;
+
+  if (strmh->flags & UVC_STREAM_FLAG_ZERO_COPY) {
+    /* lend the slot itself; it is not reused until the consumer hands it
+     * back with uvc_stream_release_buffer() */
+    if (frame->library_owns_data)
+      free(frame->data);
+    frame->library_owns_data = 0;
+    frame->data = slot->buf;
+    frame->data_bytes = slot->bytes;
+    frame->metadata = slot->meta_bytes ? slot->meta : NULL;
+    frame->metadata_bytes = slot->meta_bytes;
+    slot->state = UVC_FRAME_SLOT_LENT;
+    return;
+  }
 
-  frame_desc = uvc_find_frame_desc(strmh->devh, strmh->cur_ctrl.bFormatIndex,
-				   strmh->cur_ctrl.bFrameIndex);
+  memcpy(strmh->frame_meta, slot->meta, slot->meta_bytes);
+  frame->metadata = slot->meta_bytes ? strmh->frame_meta : NULL;
+  frame->metadata_bytes = slot->meta_bytes;
 
-  frame->frame_format = strmh->frame_format;
-  
-  frame->width = frame_desc->wWidth;
-  frame->height = frame_desc->wHeight;
-  
-  switch (frame->frame_format) {
-  case UVC_FRAME_FORMAT_YUYV:
-    frame->step = frame->width * 2;
-    break;
-  case UVC_FRAME_FORMAT_MJPEG:
-    frame->step = 0;
-    break;
-  default:
-    frame->step = 0;
-    break;
+  if (!frame->library_owns_data) {
+    frame->data = NULL;
+    frame->data_bytes = 0;
+    frame->library_owns_data = 1;
   }
 
-  frame->sequence = strmh->hold_seq;
-  /** @todo set the frame time */
-  // frame->capture_time
+  need = slot->bytes;
+  dht = (strmh->flags & UVC_STREAM_FLAG_MJPEG_DHT) && frame->frame_format == UVC_FRAME_FORMAT_MJPEG;
+  if (dht)
+    need += UVC_MJPEG_DHT_BYTES;
 
-  /* copy the image data from the hold buffer to the frame (unnecessary extra buf?) */
-  if (frame->data_bytes < strmh->hold_bytes) {
-    frame->data = realloc(frame->data, strmh->hold_bytes);
+  /* copy the image data from the slot to the frame (unnecessary extra buf?) */
+  if (frame->data_bytes < need) {
+    frame->data = realloc(frame->data, need);
   }
-  frame->data_bytes = strmh->hold_bytes;
-  memcpy(frame->data, strmh->holdbuf, frame->data_bytes);
+  if (dht) {
+    frame->data_bytes = uvc_mjpeg_copy_dht(frame->data, slot->buf, slot->bytes);
+  } else {
+    frame->data_bytes = slot->bytes;
+    memcpy(frame->data, slot->buf, frame->data_bytes);
+  }
+  slot->state = UVC_FRAME_SLOT_FREE;
+}
+
+/** @brief Hand a lent frame buffer back to the stream
+ * @ingroup streaming
+ *
+ * With UVC_STREAM_FLAG_ZERO_COPY, frames point directly into one of the
+ * stream's frame slots. Frames completed while every other slot is lent are
+ * dropped, so release it as soon as the data is no longer needed.
+ *
+ * The slot is only freed if it still holds that very frame: a stale or
+ * repeated release, whose slot has been reused for a later frame since, is
+ * ignored.
+ *
+ * @param strmh UVC stream
+ * @param data Data pointer of the frame being released
+ * @param sequence Sequence number of the frame being released
+ */
+void uvc_stream_release_buffer(uvc_stream_handle_t *strmh, void *data, uint32_t sequence) {
+  int i;
+
+  pthread_mutex_lock(&strmh->cb_mutex);
+
+  for (i = 0; i < strmh->num_slots; i++) {
+    if (strmh->slots[i].state == UVC_FRAME_SLOT_LENT && strmh->slots[i].buf == data
+        && strmh->slots[i].seq == sequence) {
+      strmh->slots[i].state = UVC_FRAME_SLOT_FREE;
+      break;
+    }
+  }
+
+  pthread_mutex_unlock(&strmh->cb_mutex);
+}
+
+/** @brief Count the frame buffers lent to the consumer
+ * @ingroup streaming
+ *
+ * With UVC_STREAM_FLAG_ZERO_COPY, frames not yet handed back with
+ * uvc_stream_release_buffer(). uvc_stream_start() refuses to start while
+ * there are any, and uvc_stream_close() frees them regardless.
+ *
+ * @param strmh UVC stream
+ * @return Number of lent frame buffers
+ */
+int uvc_stream_lent_buffers(uvc_stream_handle_t *strmh) {
+  int i, n = 0;
+
+  pthread_mutex_lock(&strmh->cb_mutex);
+  for (i = 0; i < strmh->num_slots; i++) {
+    if (strmh->slots[i].state == UVC_FRAME_SLOT_LENT)
+      n++;
+  }
+  pthread_mutex_unlock(&strmh->cb_mutex);
 
+  return n;
+}
 
+/** @brief Read the stream counters
+ * @ingroup streaming
+ *
+ * @param strmh UVC stream
+ * @param[out] stats Counters since the stream was opened
+ */
+void uvc_stream_get_stats(uvc_stream_handle_t *strmh, uvc_stream_stats_t *stats) {
+  pthread_mutex_lock(&strmh->cb_mutex);
+  *stats = strmh->stats;
+  pthread_mutex_unlock(&strmh->cb_mutex);
+}
 
+/** @brief Read the host monotonic clock
+ * @ingroup streaming
+ *
+ * The clock of uvc_frame_t.arrival_ns, unaffected by changes to the system
+ * time.
+ *
+ * @return Host monotonic time in ns
+ */
+int64_t uvc_monotonic_ns(void) {
+  return _uvc_monotonic_ns();
 }
 
 /** Poll for a frame
@@ -7152,6 +8470,7 @@ uvc_error_t uvc_stream_get_frame(uvc_stream_handle_t *strmh,
   time_t add_nsecs;
   struct timespec ts;
   struct timeval tv;
+  struct uvc_frame_slot *slot;
 
   if (!strmh->running)
     return UVC_ERROR_INVALID_PARAM;
@@ -7161,10 +8480,9 @@ uvc_error_t uvc_stream_get_frame(uvc_stream_handle_t *strmh,
 
   pthread_mutex_lock(&strmh->cb_mutex);
 
-  if (strmh->last_polled_seq < strmh->hold_seq) {
-    _uvc_populate_frame(strmh);
+  if ((slot = _uvc_next_ready_slot(strmh))) {
+    _uvc_populate_frame(strmh, slot);
     *frame = &strmh->frame;
-    strmh->last_polled_seq = strmh->hold_seq;
   } else if (timeout_us != -1) {
     if (timeout_us == 0) {
       pthread_cond_wait(&strmh->cb_cond, &strmh->cb_mutex);
@@ -7198,17 +8516,18 @@ uvc_error_t uvc_stream_get_frame(uvc_stream_handle_t *strmh,
       switch(err){
       case EINVAL:
           *frame = NULL;
+          pthread_mutex_unlock(&strmh->cb_mutex);
           return UVC_ERROR_OTHER;
       case ETIMEDOUT:
           *frame = NULL;
+          pthread_mutex_unlock(&strmh->cb_mutex);
           return UVC_ERROR_TIMEOUT;
       }
     }
     
-    if (strmh->last_polled_seq < strmh->hold_seq) {
-      _uvc_populate_frame(strmh);
+    if ((slot = _uvc_next_ready_slot(strmh))) {
+      _uvc_populate_frame(strmh, slot);
       *frame = &strmh->frame;
-      strmh->last_polled_seq = strmh->hold_seq;
     } else {
       *frame = NULL;
     }
@@ -7257,9 +8576,7 @@ uvc_error_t uvc_stream_stop(uvc_stream_handle_t *strmh) {
     if(strmh->transfers[i] != NULL) {
       int res = libusb_cancel_transfer(strmh->transfers[i]);
       if(res < 0 && res != LIBUSB_ERROR_NOT_FOUND ) {
-        free(strmh->transfers[i]->buffer);
-        libusb_free_transfer(strmh->transfers[i]);
-        strmh->transfers[i] = NULL;
+        _uvc_free_transfer(strmh, i);
       }
     }
   }
@@ -7292,21 +8609,25 @@ uvc_error_t uvc_stream_stop(uvc_stream_handle_t *strmh) {
 /** @brief Close stream.
  * @ingroup streaming
  *
- * Closes stream, frees handle and all streaming resources.
+ * Closes stream, frees handle and all streaming resources, including the
+ * buffers of frames still lent (see uvc_stream_lent_buffers()).
  *
  * @param strmh UVC stream handle
  */
 void uvc_stream_close(uvc_stream_handle_t *strmh) {
+  int i;
+
   if (strmh->running)
     uvc_stream_stop(strmh);
 
   uvc_release_if(strmh->devh, strmh->stream_if->bInterfaceNumber);
 
-  if (strmh->frame.data)
+  if (strmh->frame.data && strmh->frame.library_owns_data)
     free(strmh->frame.data);
 
-  free(strmh->outbuf);
-  free(strmh->holdbuf);
+  for (i = 0; i < strmh->num_slots; i++)
+    free(strmh->slots[i].mem);
+  free(strmh->slots);
 
   pthread_cond_destroy(&strmh->cb_cond);
   pthread_mutex_destroy(&strmh->cb_mutex);
@@ -7438,6 +8759,14 @@ uvc_error_t uvc_duplicate_frame(uvc_frame_t *in, uvc_frame_t *out) {
   out->step = in->step;
   out->sequence = in->sequence;
   out->capture_time = in->capture_time;
+  out->arrival_time = in->arrival_time;
+  out->arrival_ns = in->arrival_ns;
+  out->errors = in->errors;
+  out->pts = in->pts;
+  out->scr = in->scr;
+  out->sof = in->sof;
+  out->has_pts = in->has_pts;
+  out->has_scr = in->has_scr;
   out->source = in->source;
 
   memcpy(out->data, in->data, in->data_bytes);
@@ -7456,316 +8785,2261 @@ uvc_error_t uvc_duplicate_frame(uvc_frame_t *in, uvc_frame_t *out) {
     (prgb)[4] = sat(pyuv[2] + g); \
     (prgb)[5] = sat(pyuv[2] + b); \
     }
-#define IYUYV2RGB_2(pyuv, prgb) { \
-    int r = (22987 * ((pyuv)[3] - 128)) >> 14; \
-    int g = (-5636 * ((pyuv)[1] - 128) - 11698 * ((pyuv)[3] - 128)) >> 14; \
-    int b = (29049 * ((pyuv)[1] - 128)) >> 14; \
-    (prgb)[0] = sat(*(pyuv) + r); \
-    (prgb)[1] = sat(*(pyuv) + g); \
-    (prgb)[2] = sat(*(pyuv) + b); \
-    (prgb)[3] = sat((pyuv)[2] + r); \
-    (prgb)[4] = sat((pyuv)[2] + g); \
-    (prgb)[5] = sat((pyuv)[2] + b); \
-    }
-#define IYUYV2RGB_16(pyuv, prgb) IYUYV2RGB_8(pyuv, prgb); IYUYV2RGB_8(pyuv + 16, prgb + 24);
-#define IYUYV2RGB_8(pyuv, prgb) IYUYV2RGB_4(pyuv, prgb); IYUYV2RGB_4(pyuv + 8, prgb + 12);
-#define IYUYV2RGB_4(pyuv, prgb) IYUYV2RGB_2(pyuv, prgb); IYUYV2RGB_2(pyuv + 4, prgb + 6);
 
-/** @brief Convert a frame from YUYV to RGB
- * @ingroup frame
+/* Conversion worker pool.
  *
- * @param in YUYV frame
- * @param out RGB frame
+ * Large frames are converted in bands of rows, shared between the calling
+ * thread and uvc_set_conversion_threads() - 1 persistent workers. One
+ * conversion runs on the pool at a time; others that find it taken convert
+ * on their own thread instead of waiting for it.
+ */
+typedef void (_uvc_rows_fn_t)(void *arg, uint32_t row_begin, uint32_t row_end);
+
+static struct {
+  /** held by set_threads and by the caller whose job the workers run */
+  pthread_mutex_t owner;
+  /** protects the job state, signaled with start and finish */
+  pthread_mutex_t lock;
+  pthread_cond_t start;
+  pthread_cond_t finish;
+  pthread_t threads[LIBUVC_MAX_CONVERSION_THREADS];
+  int num_workers;
+  int quit;
+  unsigned job;
+  _uvc_rows_fn_t *fn;
+  void *arg;
+  uint32_t rows;
+  int bands;
+  int next_band;
+  int unfinished_bands;
+} _uvc_pool = {
+  PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER,
+  PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER
+};
+
+/** @internal
+ * @brief Convert bands of the current job until none are left
+ * must be called with the pool lock held!
  */
-uvc_error_t uvc_yuyv2rgb(uvc_frame_t *in, uvc_frame_t *out) {
-  if (in->frame_format != UVC_FRAME_FORMAT_YUYV)
-    return UVC_ERROR_INVALID_PARAM;
+static void _uvc_pool_run_bands(void) {
+  while (_uvc_pool.next_band < _uvc_pool.bands) {
+    int band = _uvc_pool.next_band++;
+    uint64_t rows = _uvc_pool.rows;
+    int bands = _uvc_pool.bands;
 
-  if (uvc_ensure_frame_size(out, in->width * in->height * 3) < 0)
-    return UVC_ERROR_NO_MEM;
+    pthread_mutex_unlock(&_uvc_pool.lock);
+    _uvc_pool.fn(_uvc_pool.arg, rows * band / bands, rows * (band + 1) / bands);
+    pthread_mutex_lock(&_uvc_pool.lock);
 
-  out->width = in->width;
-  out->height = in->height;
-  out->frame_format = UVC_FRAME_FORMAT_RGB;
-  out->step = in->width * 3;
-  out->sequence = in->sequence;
-  out->capture_time = in->capture_time;
-  out->source = in->source;
+    if (--_uvc_pool.unfinished_bands == 0)
+      pthread_cond_broadcast(&_uvc_pool.finish);
+  }
+}
 
-  uint8_t *pyuv = in->data;
-  uint8_t *prgb = out->data;
-  uint8_t *prgb_end = prgb + out->data_bytes;
+static void *_uvc_pool_worker(void *unused) {
+  unsigned seen;
 
-  while (prgb < prgb_end) {
-    IYUYV2RGB_8(pyuv, prgb);
+  pthread_mutex_lock(&_uvc_pool.lock);
 
-    prgb += 3 * 8;
-    pyuv += 2 * 8;
+  seen = _uvc_pool.job;
+  while (!_uvc_pool.quit) {
+    if (_uvc_pool.job != seen) {
+      seen = _uvc_pool.job;
+      _uvc_pool_run_bands();
+    } else {
+      pthread_cond_wait(&_uvc_pool.start, &_uvc_pool.lock);
+    }
   }
 
-  return UVC_SUCCESS;
+  pthread_mutex_unlock(&_uvc_pool.lock);
+  return NULL;
 }
 
-#define IYUYV2BGR_2(pyuv, pbgr) { \
-    int r = (22987 * ((pyuv)[3] - 128)) >> 14; \
-    int g = (-5636 * ((pyuv)[1] - 128) - 11698 * ((pyuv)[3] - 128)) >> 14; \
-    int b = (29049 * ((pyuv)[1] - 128)) >> 14; \
-    (pbgr)[0] = sat(*(pyuv) + b); \
-    (pbgr)[1] = sat(*(pyuv) + g); \
-    (pbgr)[2] = sat(*(pyuv) + r); \
-    (pbgr)[3] = sat((pyuv)[2] + b); \
-    (pbgr)[4] = sat((pyuv)[2] + g); \
-    (pbgr)[5] = sat((pyuv)[2] + r); \
-    }
-#define IYUYV2BGR_16(pyuv, pbgr) IYUYV2BGR_8(pyuv, pbgr); IYUYV2BGR_8(pyuv + 16, pbgr + 24);
-#define IYUYV2BGR_8(pyuv, pbgr) IYUYV2BGR_4(pyuv, pbgr); IYUYV2BGR_4(pyuv + 8, pbgr + 12);
-#define IYUYV2BGR_4(pyuv, pbgr) IYUYV2BGR_2(pyuv, pbgr); IYUYV2BGR_2(pyuv + 4, pbgr + 6);
-
-/** @brief Convert a frame from YUYV to BGR
- * @ingroup frame
+/** @internal
+ * @brief Run fn over rows [0, rows), split across the pool if worthwhile
  *
- * @param in YUYV frame
- * @param out BGR frame
+ * @param row_pixels Pixels per row, to judge how many bands pay off
  */
-uvc_error_t uvc_yuyv2bgr(uvc_frame_t *in, uvc_frame_t *out) {
-  if (in->frame_format != UVC_FRAME_FORMAT_YUYV)
-    return UVC_ERROR_INVALID_PARAM;
+static void _uvc_parallel_rows(_uvc_rows_fn_t *fn, void *arg, uint32_t rows, size_t row_pixels) {
+  uint64_t max_bands = (uint64_t) rows * row_pixels / LIBUVC_CONVERSION_BAND_PIXELS;
+  int bands;
 
-  if (uvc_ensure_frame_size(out, in->width * in->height * 3) < 0)
-    return UVC_ERROR_NO_MEM;
+  if (max_bands < 2 || pthread_mutex_trylock(&_uvc_pool.owner) != 0) {
+    fn(arg, 0, rows);
+    return;
+  }
 
-  out->width = in->width;
-  out->height = in->height;
-  out->frame_format = UVC_FRAME_FORMAT_BGR;
-  out->step = in->width * 3;
-  out->sequence = in->sequence;
-  out->capture_time = in->capture_time;
-  out->source = in->source;
+  bands = _uvc_pool.num_workers + 1;
+  if (bands > max_bands)
+    bands = max_bands;
+  if (bands > rows)
+    bands = rows;
 
-  uint8_t *pyuv = in->data;
-  uint8_t *pbgr = out->data;
-  uint8_t *pbgr_end = pbgr + out->data_bytes;
+  if (bands < 2) {
+    pthread_mutex_unlock(&_uvc_pool.owner);
+    fn(arg, 0, rows);
+    return;
+  }
 
-  while (pbgr < pbgr_end) {
-    IYUYV2BGR_8(pyuv, pbgr);
+  pthread_mutex_lock(&_uvc_pool.lock);
 
-    pbgr += 3 * 8;
-    pyuv += 2 * 8;
-  }
+  _uvc_pool.fn = fn;
+  _uvc_pool.arg = arg;
+  _uvc_pool.rows = rows;
+  _uvc_pool.bands = bands;
+  _uvc_pool.next_band = 0;
+  _uvc_pool.unfinished_bands = bands;
+  _uvc_pool.job++;
+  pthread_cond_broadcast(&_uvc_pool.start);
+
+  _uvc_pool_run_bands();
+  while (_uvc_pool.unfinished_bands > 0)
+    pthread_cond_wait(&_uvc_pool.finish, &_uvc_pool.lock);
+
+  pthread_mutex_unlock(&_uvc_pool.lock);
+  pthread_mutex_unlock(&_uvc_pool.owner);
+}
+
+/** @brief Set the number of threads frame conversions may use
+ * @ingroup frame
+ *
+ * Frames of at least two bands of LIBUVC_CONVERSION_BAND_PIXELS pixels are
+ * split into row bands, converted by the calling thread together with
+ * num_threads - 1 persistent workers. Only one conversion uses the workers at
+ * a time, concurrent ones run on their calling thread. The default is 1,
+ * which converts every frame on the calling thread.
+ *
+ * @param num_threads Threads per conversion, 1 to LIBUVC_MAX_CONVERSION_THREADS
+ */
+uvc_error_t uvc_set_conversion_threads(int num_threads) {
+  uvc_error_t ret = UVC_SUCCESS;
+  int i;
+
+  if (num_threads < 1 || num_threads > LIBUVC_MAX_CONVERSION_THREADS)
+    return UVC_ERROR_INVALID_PARAM;
+
+  pthread_mutex_lock(&_uvc_pool.owner);
+
+  pthread_mutex_lock(&_uvc_pool.lock);
+  _uvc_pool.quit = 1;
+  pthread_cond_broadcast(&_uvc_pool.start);
+  pthread_mutex_unlock(&_uvc_pool.lock);
+
+  for (i = 0; i < _uvc_pool.num_workers; i++)
+    pthread_join(_uvc_pool.threads[i], NULL);
+
+  _uvc_pool.num_workers = 0;
+  _uvc_pool.quit = 0;
+
+  for (i = 0; i < num_threads - 1; i++) {
+    if (pthread_create(&_uvc_pool.threads[i], NULL, _uvc_pool_worker, NULL) != 0) {
+      ret = UVC_ERROR_NO_MEM;
+      break;
+    }
+    _uvc_pool.num_workers++;
+  }
+
+  pthread_mutex_unlock(&_uvc_pool.owner);
+
+  return ret;
+}
+
+/** @brief Get the number of threads frame conversions may use
+ * @ingroup frame
+ */
+int uvc_get_conversion_threads(void) {
+  int num_threads;
+
+  pthread_mutex_lock(&_uvc_pool.owner);
+  num_threads = _uvc_pool.num_workers + 1;
+  pthread_mutex_unlock(&_uvc_pool.owner);
+
+  return num_threads;
+}
+
+/* Packed 4:2:2 to 24-bit RGB/BGR kernels.
+ *
+ * All of them compute, for each pixel pair with chroma u, v (minus 128),
+ *   r = (22987 * v) >> 14
+ *   g = (-5636 * u - 11698 * v) >> 14
+ *   b = (29049 * u) >> 14
+ * and saturate y + r/g/b to 0..255, so the SIMD versions are bit-identical
+ * to the scalar one. @p uyvy selects UYVY instead of YUYV input, @p bgr BGR
+ * instead of RGB output. They convert @p pairs two-pixel groups.
+ */
+typedef void (_uvc_yuv422_rgb_kernel_t)(const uint8_t *in, uint8_t *out, size_t pairs, int uyvy, int bgr);
+
+static void _uvc_yuv422_rgb_c(const uint8_t *in, uint8_t *out, size_t pairs, int uyvy, int bgr) {
+  int y = uyvy ? 1 : 0, c = uyvy ? 0 : 1;
+  int ri = bgr ? 2 : 0, bi = bgr ? 0 : 2;
+
+  for (; pairs > 0; pairs--, in += 4, out += 6) {
+    int u = in[c] - 128;
+    int v = in[c + 2] - 128;
+    int r = (22987 * v) >> 14;
+    int g = (-5636 * u - 11698 * v) >> 14;
+    int b = (29049 * u) >> 14;
+
+    out[ri] = sat(in[y] + r);
+    out[1] = sat(in[y] + g);
+    out[bi] = sat(in[y] + b);
+    out[3 + ri] = sat(in[y + 2] + r);
+    out[4] = sat(in[y + 2] + g);
+    out[3 + bi] = sat(in[y + 2] + b);
+  }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+/* pshufb masks spreading 16 bytes of one channel over 48 bytes of packed
+ * 24-bit pixels, [channel][output vector] */
+static const uint8_t _uvc_rgb_interleave[3][3][16] __attribute__((aligned(16))) = {
+  {{0,0x80,0x80,1,0x80,0x80,2,0x80,0x80,3,0x80,0x80,4,0x80,0x80,5},
+   {0x80,0x80,6,0x80,0x80,7,0x80,0x80,8,0x80,0x80,9,0x80,0x80,10,0x80},
+   {0x80,11,0x80,0x80,12,0x80,0x80,13,0x80,0x80,14,0x80,0x80,15,0x80,0x80}},
+  {{0x80,0,0x80,0x80,1,0x80,0x80,2,0x80,0x80,3,0x80,0x80,4,0x80,0x80},
+   {5,0x80,0x80,6,0x80,0x80,7,0x80,0x80,8,0x80,0x80,9,0x80,0x80,10},
+   {0x80,0x80,11,0x80,0x80,12,0x80,0x80,13,0x80,0x80,14,0x80,0x80,15,0x80}},
+  {{0x80,0x80,0,0x80,0x80,1,0x80,0x80,2,0x80,0x80,3,0x80,0x80,4,0x80},
+   {0x80,5,0x80,0x80,6,0x80,0x80,7,0x80,0x80,8,0x80,0x80,9,0x80,0x80},
+   {10,0x80,0x80,11,0x80,0x80,12,0x80,0x80,13,0x80,0x80,14,0x80,0x80,15}},
+};
+
+/* Store 16 pixels given as one vector per output channel */
+__attribute__((target("ssse3")))
+static inline void _uvc_store_rgb_ssse3(uint8_t *out, __m128i c0, __m128i c1, __m128i c2) {
+  int i;
+
+  for (i = 0; i < 3; i++) {
+    __m128i v = _mm_or_si128(
+        _mm_or_si128(
+          _mm_shuffle_epi8(c0, _mm_load_si128((const __m128i *) _uvc_rgb_interleave[0][i])),
+          _mm_shuffle_epi8(c1, _mm_load_si128((const __m128i *) _uvc_rgb_interleave[1][i]))),
+        _mm_shuffle_epi8(c2, _mm_load_si128((const __m128i *) _uvc_rgb_interleave[2][i])));
+    _mm_storeu_si128((__m128i *) (out + 16 * i), v);
+  }
+}
+
+/* SSE2 has no byte shuffle to interleave the channels, so the x86 baseline
+ * kernel needs SSSE3 */
+__attribute__((target("ssse3")))
+static void _uvc_yuv422_rgb_ssse3(const uint8_t *in, uint8_t *out, size_t pairs, int uyvy, int bgr) {
+  const __m128i lo = _mm_set1_epi16(0x00ff);
+  const __m128i c128 = _mm_set1_epi16(128);
+  /* coefficients for (u, v) pairs of 16 bit lanes */
+  const __m128i kr = _mm_set1_epi32(22987 << 16);
+  const __m128i kg = _mm_set1_epi32((int) (((uint32_t) (uint16_t) -11698 << 16) | (uint16_t) -5636));
+  const __m128i kb = _mm_set1_epi32(29049);
+  const __m128i yshift = _mm_cvtsi32_si128(uyvy ? 8 : 0);
+  const __m128i cshift = _mm_cvtsi32_si128(uyvy ? 0 : 8);
+
+  for (; pairs >= 8; pairs -= 8, in += 32, out += 48) {
+    __m128i a = _mm_loadu_si128((const __m128i *) in);
+    __m128i b = _mm_loadu_si128((const __m128i *) (in + 16));
+    __m128i ya = _mm_and_si128(_mm_srl_epi16(a, yshift), lo);
+    __m128i yb = _mm_and_si128(_mm_srl_epi16(b, yshift), lo);
+    __m128i ca = _mm_sub_epi16(_mm_and_si128(_mm_srl_epi16(a, cshift), lo), c128);
+    __m128i cb = _mm_sub_epi16(_mm_and_si128(_mm_srl_epi16(b, cshift), lo), c128);
+    /* one offset per pair, then duplicated for both of its pixels */
+    __m128i r = _mm_packs_epi32(_mm_srai_epi32(_mm_madd_epi16(ca, kr), 14),
+                                _mm_srai_epi32(_mm_madd_epi16(cb, kr), 14));
+    __m128i g = _mm_packs_epi32(_mm_srai_epi32(_mm_madd_epi16(ca, kg), 14),
+                                _mm_srai_epi32(_mm_madd_epi16(cb, kg), 14));
+    __m128i bl = _mm_packs_epi32(_mm_srai_epi32(_mm_madd_epi16(ca, kb), 14),
+                                 _mm_srai_epi32(_mm_madd_epi16(cb, kb), 14));
+    __m128i R = _mm_packus_epi16(_mm_add_epi16(ya, _mm_unpacklo_epi16(r, r)),
+                                 _mm_add_epi16(yb, _mm_unpackhi_epi16(r, r)));
+    __m128i G = _mm_packus_epi16(_mm_add_epi16(ya, _mm_unpacklo_epi16(g, g)),
+                                 _mm_add_epi16(yb, _mm_unpackhi_epi16(g, g)));
+    __m128i B = _mm_packus_epi16(_mm_add_epi16(ya, _mm_unpacklo_epi16(bl, bl)),
+                                 _mm_add_epi16(yb, _mm_unpackhi_epi16(bl, bl)));
+
+    if (bgr)
+      _uvc_store_rgb_ssse3(out, B, G, R);
+    else
+      _uvc_store_rgb_ssse3(out, R, G, B);
+  }
+
+  _uvc_yuv422_rgb_c(in, out, pairs, uyvy, bgr);
+}
+
+__attribute__((target("avx2")))
+static void _uvc_yuv422_rgb_avx2(const uint8_t *in, uint8_t *out, size_t pairs, int uyvy, int bgr) {
+  const __m256i lo = _mm256_set1_epi16(0x00ff);
+  const __m256i c128 = _mm256_set1_epi16(128);
+  const __m256i kr = _mm256_set1_epi32(22987 << 16);
+  const __m256i kg = _mm256_set1_epi32((int) (((uint32_t) (uint16_t) -11698 << 16) | (uint16_t) -5636));
+  const __m256i kb = _mm256_set1_epi32(29049);
+  const __m128i yshift = _mm_cvtsi32_si128(uyvy ? 8 : 0);
+  const __m128i cshift = _mm_cvtsi32_si128(uyvy ? 0 : 8);
+
+  for (; pairs >= 16; pairs -= 16, in += 64, out += 96) {
+    /* 128 bit lanes: a = pixels 0-7 | 8-15, b = 16-23 | 24-31 */
+    __m256i a = _mm256_loadu_si256((const __m256i *) in);
+    __m256i b = _mm256_loadu_si256((const __m256i *) (in + 32));
+    __m256i ya = _mm256_and_si256(_mm256_srl_epi16(a, yshift), lo);
+    __m256i yb = _mm256_and_si256(_mm256_srl_epi16(b, yshift), lo);
+    __m256i ca = _mm256_sub_epi16(_mm256_and_si256(_mm256_srl_epi16(a, cshift), lo), c128);
+    __m256i cb = _mm256_sub_epi16(_mm256_and_si256(_mm256_srl_epi16(b, cshift), lo), c128);
+    __m256i r = _mm256_packs_epi32(_mm256_srai_epi32(_mm256_madd_epi16(ca, kr), 14),
+                                   _mm256_srai_epi32(_mm256_madd_epi16(cb, kr), 14));
+    __m256i g = _mm256_packs_epi32(_mm256_srai_epi32(_mm256_madd_epi16(ca, kg), 14),
+                                   _mm256_srai_epi32(_mm256_madd_epi16(cb, kg), 14));
+    __m256i bl = _mm256_packs_epi32(_mm256_srai_epi32(_mm256_madd_epi16(ca, kb), 14),
+                                    _mm256_srai_epi32(_mm256_madd_epi16(cb, kb), 14));
+    /* packing is per lane: bytes come out as pixels 0-7, 16-23, 8-15, 24-31 */
+    __m256i R = _mm256_permute4x64_epi64(
+        _mm256_packus_epi16(_mm256_add_epi16(ya, _mm256_unpacklo_epi16(r, r)),
+                            _mm256_add_epi16(yb, _mm256_unpackhi_epi16(r, r))), 0xd8);
+    __m256i G = _mm256_permute4x64_epi64(
+        _mm256_packus_epi16(_mm256_add_epi16(ya, _mm256_unpacklo_epi16(g, g)),
+                            _mm256_add_epi16(yb, _mm256_unpackhi_epi16(g, g))), 0xd8);
+    __m256i B = _mm256_permute4x64_epi64(
+        _mm256_packus_epi16(_mm256_add_epi16(ya, _mm256_unpacklo_epi16(bl, bl)),
+                            _mm256_add_epi16(yb, _mm256_unpackhi_epi16(bl, bl))), 0xd8);
+
+    if (bgr) {
+      __m256i t = R;
+      R = B;
+      B = t;
+    }
+
+    _uvc_store_rgb_ssse3(out, _mm256_castsi256_si128(R), _mm256_castsi256_si128(G),
+                         _mm256_castsi256_si128(B));
+    _uvc_store_rgb_ssse3(out + 48, _mm256_extracti128_si256(R, 1), _mm256_extracti128_si256(G, 1),
+                         _mm256_extracti128_si256(B, 1));
+  }
+
+  _uvc_yuv422_rgb_ssse3(in, out, pairs, uyvy, bgr);
+}
+#endif
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+
+/* (c - 128) * k >> 14 for 8 chroma samples, narrowed back to 16 bits */
+#define UVC_NEON_MUL14(c, k) \
+  vcombine_s16(vshrn_n_s32(vmull_n_s16(vget_low_s16(c), k), 14), \
+               vshrn_n_s32(vmull_n_s16(vget_high_s16(c), k), 14))
+
+/* 8 luma samples plus offsets, saturated to bytes */
+#define UVC_NEON_ADD_Y(y, o) \
+  vqmovun_s16(vaddq_s16(vreinterpretq_s16_u16(vmovl_u8(y)), (o)))
+
+static void _uvc_yuv422_rgb_neon(const uint8_t *in, uint8_t *out, size_t pairs, int uyvy, int bgr) {
+  const uint8x8_t c128 = vdup_n_u8(128);
+
+  for (; pairs >= 16; pairs -= 16, in += 64, out += 96) {
+    /* YUYV: Y0 U Y1 V, UYVY: U Y0 V Y1 */
+    uint8x16x4_t p = vld4q_u8(in);
+    uint8x16_t y0 = uyvy ? p.val[1] : p.val[0];
+    uint8x16_t y1 = uyvy ? p.val[3] : p.val[2];
+    uint8x16_t u8 = uyvy ? p.val[0] : p.val[1];
+    uint8x16_t v8 = uyvy ? p.val[2] : p.val[3];
+    uint8x16x3_t px[2];
+    int h;
+
+    for (h = 0; h < 2; h++) {
+      /* pairs 8h .. 8h+7 */
+      uint8x8_t uh = h ? vget_high_u8(u8) : vget_low_u8(u8);
+      uint8x8_t vh = h ? vget_high_u8(v8) : vget_low_u8(v8);
+      uint8x8_t y0h = h ? vget_high_u8(y0) : vget_low_u8(y0);
+      uint8x8_t y1h = h ? vget_high_u8(y1) : vget_low_u8(y1);
+      int16x8_t u = vreinterpretq_s16_u16(vsubl_u8(uh, c128));
+      int16x8_t v = vreinterpretq_s16_u16(vsubl_u8(vh, c128));
+      int16x8_t r = UVC_NEON_MUL14(v, 22987);
+      int16x8_t b = UVC_NEON_MUL14(u, 29049);
+      int16x8_t g = vcombine_s16(
+          vshrn_n_s32(vmlal_n_s16(vmull_n_s16(vget_low_s16(u), -5636), vget_low_s16(v), -11698), 14),
+          vshrn_n_s32(vmlal_n_s16(vmull_n_s16(vget_high_s16(u), -5636), vget_high_s16(v), -11698), 14));
+      /* even and odd pixels, zipped back into pixel order */
+      uint8x8x2_t R = vzip_u8(UVC_NEON_ADD_Y(y0h, r), UVC_NEON_ADD_Y(y1h, r));
+      uint8x8x2_t G = vzip_u8(UVC_NEON_ADD_Y(y0h, g), UVC_NEON_ADD_Y(y1h, g));
+      uint8x8x2_t B = vzip_u8(UVC_NEON_ADD_Y(y0h, b), UVC_NEON_ADD_Y(y1h, b));
+
+      px[h].val[bgr ? 2 : 0] = vcombine_u8(R.val[0], R.val[1]);
+      px[h].val[1] = vcombine_u8(G.val[0], G.val[1]);
+      px[h].val[bgr ? 0 : 2] = vcombine_u8(B.val[0], B.val[1]);
+    }
+
+    vst3q_u8(out, px[0]);
+    vst3q_u8(out + 48, px[1]);
+  }
+
+  _uvc_yuv422_rgb_c(in, out, pairs, uyvy, bgr);
+}
+
+#undef UVC_NEON_MUL14
+#undef UVC_NEON_ADD_Y
+#endif
+
+/* Packed 4:2:2 to planar 4:2:0 kernels.
+ *
+ * They split two input rows @p in0, @p in1 of @p pairs two-pixel groups into
+ * luma rows @p y0, @p y1 and one chroma row, each chroma sample the rounded
+ * average (a + b + 1) >> 1 of the two rows. With @p v set that row goes to
+ * separate @p u and @p v planes (I420), otherwise interleaved to @p u (NV12).
+ * @p uyvy selects UYVY instead of YUYV input.
+ */
+typedef void (_uvc_yuv422_420_kernel_t)(const uint8_t *in0, const uint8_t *in1, uint8_t *y0, uint8_t *y1,
+                                        uint8_t *u, uint8_t *v, size_t pairs, int uyvy);
+
+static void _uvc_yuv422_420_c(const uint8_t *in0, const uint8_t *in1, uint8_t *y0, uint8_t *y1,
+                              uint8_t *u, uint8_t *v, size_t pairs, int uyvy) {
+  int y = uyvy ? 1 : 0, c = uyvy ? 0 : 1;
+
+  for (; pairs > 0; pairs--, in0 += 4, in1 += 4, y0 += 2, y1 += 2) {
+    uint8_t cu = (in0[c] + in1[c] + 1) >> 1;
+    uint8_t cv = (in0[c + 2] + in1[c + 2] + 1) >> 1;
+
+    y0[0] = in0[y];
+    y0[1] = in0[y + 2];
+    y1[0] = in1[y];
+    y1[1] = in1[y + 2];
+
+    if (v) {
+      *u++ = cu;
+      *v++ = cv;
+    } else {
+      u[0] = cu;
+      u[1] = cv;
+      u += 2;
+    }
+  }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("sse2")))
+static void _uvc_yuv422_420_sse2(const uint8_t *in0, const uint8_t *in1, uint8_t *y0, uint8_t *y1,
+                                 uint8_t *u, uint8_t *v, size_t pairs, int uyvy) {
+  const __m128i lo = _mm_set1_epi16(0x00ff);
+  const __m128i yshift = _mm_cvtsi32_si128(uyvy ? 8 : 0);
+  const __m128i cshift = _mm_cvtsi32_si128(uyvy ? 0 : 8);
+
+  for (; pairs >= 8; pairs -= 8, in0 += 32, in1 += 32, y0 += 16, y1 += 16) {
+    __m128i a0 = _mm_loadu_si128((const __m128i *) in0);
+    __m128i a1 = _mm_loadu_si128((const __m128i *) (in0 + 16));
+    __m128i b0 = _mm_loadu_si128((const __m128i *) in1);
+    __m128i b1 = _mm_loadu_si128((const __m128i *) (in1 + 16));
+    /* chroma as U V U V ..., already the NV12 layout */
+    __m128i c = _mm_avg_epu8(
+        _mm_packus_epi16(_mm_and_si128(_mm_srl_epi16(a0, cshift), lo),
+                         _mm_and_si128(_mm_srl_epi16(a1, cshift), lo)),
+        _mm_packus_epi16(_mm_and_si128(_mm_srl_epi16(b0, cshift), lo),
+                         _mm_and_si128(_mm_srl_epi16(b1, cshift), lo)));
+
+    _mm_storeu_si128((__m128i *) y0, _mm_packus_epi16(_mm_and_si128(_mm_srl_epi16(a0, yshift), lo),
+                                                      _mm_and_si128(_mm_srl_epi16(a1, yshift), lo)));
+    _mm_storeu_si128((__m128i *) y1, _mm_packus_epi16(_mm_and_si128(_mm_srl_epi16(b0, yshift), lo),
+                                                      _mm_and_si128(_mm_srl_epi16(b1, yshift), lo)));
+
+    if (v) {
+      __m128i uv = _mm_packus_epi16(_mm_and_si128(c, lo), _mm_srli_epi16(c, 8));
+      _mm_storel_epi64((__m128i *) u, uv);
+      _mm_storel_epi64((__m128i *) v, _mm_unpackhi_epi64(uv, uv));
+      u += 8;
+      v += 8;
+    } else {
+      _mm_storeu_si128((__m128i *) u, c);
+      u += 16;
+    }
+  }
+
+  _uvc_yuv422_420_c(in0, in1, y0, y1, u, v, pairs, uyvy);
+}
+
+__attribute__((target("avx2")))
+static void _uvc_yuv422_420_avx2(const uint8_t *in0, const uint8_t *in1, uint8_t *y0, uint8_t *y1,
+                                 uint8_t *u, uint8_t *v, size_t pairs, int uyvy) {
+  const __m256i lo = _mm256_set1_epi16(0x00ff);
+  const __m128i yshift = _mm_cvtsi32_si128(uyvy ? 8 : 0);
+  const __m128i cshift = _mm_cvtsi32_si128(uyvy ? 0 : 8);
+
+  for (; pairs >= 16; pairs -= 16, in0 += 64, in1 += 64, y0 += 32, y1 += 32) {
+    __m256i a0 = _mm256_loadu_si256((const __m256i *) in0);
+    __m256i a1 = _mm256_loadu_si256((const __m256i *) (in0 + 32));
+    __m256i b0 = _mm256_loadu_si256((const __m256i *) in1);
+    __m256i b1 = _mm256_loadu_si256((const __m256i *) (in1 + 32));
+    /* packing is per lane, the permutes restore pixel order */
+    __m256i c = _mm256_permute4x64_epi64(_mm256_avg_epu8(
+        _mm256_packus_epi16(_mm256_and_si256(_mm256_srl_epi16(a0, cshift), lo),
+                            _mm256_and_si256(_mm256_srl_epi16(a1, cshift), lo)),
+        _mm256_packus_epi16(_mm256_and_si256(_mm256_srl_epi16(b0, cshift), lo),
+                            _mm256_and_si256(_mm256_srl_epi16(b1, cshift), lo))), 0xd8);
+
+    _mm256_storeu_si256((__m256i *) y0, _mm256_permute4x64_epi64(
+        _mm256_packus_epi16(_mm256_and_si256(_mm256_srl_epi16(a0, yshift), lo),
+                            _mm256_and_si256(_mm256_srl_epi16(a1, yshift), lo)), 0xd8));
+    _mm256_storeu_si256((__m256i *) y1, _mm256_permute4x64_epi64(
+        _mm256_packus_epi16(_mm256_and_si256(_mm256_srl_epi16(b0, yshift), lo),
+                            _mm256_and_si256(_mm256_srl_epi16(b1, yshift), lo)), 0xd8));
+
+    if (v) {
+      __m256i uv = _mm256_permute4x64_epi64(
+          _mm256_packus_epi16(_mm256_and_si256(c, lo), _mm256_srli_epi16(c, 8)), 0xd8);
+      _mm_storeu_si128((__m128i *) u, _mm256_castsi256_si128(uv));
+      _mm_storeu_si128((__m128i *) v, _mm256_extracti128_si256(uv, 1));
+      u += 16;
+      v += 16;
+    } else {
+      _mm256_storeu_si256((__m256i *) u, c);
+      u += 32;
+    }
+  }
+
+  _uvc_yuv422_420_sse2(in0, in1, y0, y1, u, v, pairs, uyvy);
+}
+#endif
+
+#if defined(__aarch64__)
+static void _uvc_yuv422_420_neon(const uint8_t *in0, const uint8_t *in1, uint8_t *y0, uint8_t *y1,
+                                 uint8_t *u, uint8_t *v, size_t pairs, int uyvy) {
+  int yi = uyvy ? 1 : 0, ci = uyvy ? 0 : 1;
+
+  for (; pairs >= 16; pairs -= 16, in0 += 64, in1 += 64, y0 += 32, y1 += 32) {
+    /* YUYV: Y0 U Y1 V, UYVY: U Y0 V Y1 */
+    uint8x16x4_t a = vld4q_u8(in0);
+    uint8x16x4_t b = vld4q_u8(in1);
+    uint8x16x2_t ya = {{ a.val[yi], a.val[yi + 2] }};
+    uint8x16x2_t yb = {{ b.val[yi], b.val[yi + 2] }};
+    uint8x16x2_t c = {{ vrhaddq_u8(a.val[ci], b.val[ci]), vrhaddq_u8(a.val[ci + 2], b.val[ci + 2]) }};
+
+    vst2q_u8(y0, ya);
+    vst2q_u8(y1, yb);
+
+    if (v) {
+      vst1q_u8(u, c.val[0]);
+      vst1q_u8(v, c.val[1]);
+      u += 16;
+      v += 16;
+    } else {
+      vst2q_u8(u, c);
+      u += 32;
+    }
+  }
+
+  _uvc_yuv422_420_c(in0, in1, y0, y1, u, v, pairs, uyvy);
+}
+#endif
+
+/* Packed 4:2:2 to luma kernels, copying the Y of @p pixels pixels and
+ * skipping chroma. @p uyvy selects UYVY instead of YUYV input. */
+typedef void (_uvc_yuv422_y_kernel_t)(const uint8_t *in, uint8_t *out, size_t pixels, int uyvy);
+
+static void _uvc_yuv422_y_c(const uint8_t *in, uint8_t *out, size_t pixels, int uyvy) {
+  in += uyvy ? 1 : 0;
+
+  for (; pixels > 0; pixels--, in += 2)
+    *out++ = *in;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("sse2")))
+static void _uvc_yuv422_y_sse2(const uint8_t *in, uint8_t *out, size_t pixels, int uyvy) {
+  const __m128i lo = _mm_set1_epi16(0x00ff);
+  const __m128i yshift = _mm_cvtsi32_si128(uyvy ? 8 : 0);
+
+  for (; pixels >= 16; pixels -= 16, in += 32, out += 16) {
+    __m128i a = _mm_loadu_si128((const __m128i *) in);
+    __m128i b = _mm_loadu_si128((const __m128i *) (in + 16));
+
+    _mm_storeu_si128((__m128i *) out, _mm_packus_epi16(_mm_and_si128(_mm_srl_epi16(a, yshift), lo),
+                                                       _mm_and_si128(_mm_srl_epi16(b, yshift), lo)));
+  }
+
+  _uvc_yuv422_y_c(in, out, pixels, uyvy);
+}
+
+__attribute__((target("avx2")))
+static void _uvc_yuv422_y_avx2(const uint8_t *in, uint8_t *out, size_t pixels, int uyvy) {
+  const __m256i lo = _mm256_set1_epi16(0x00ff);
+  const __m128i yshift = _mm_cvtsi32_si128(uyvy ? 8 : 0);
+
+  for (; pixels >= 32; pixels -= 32, in += 64, out += 32) {
+    __m256i a = _mm256_loadu_si256((const __m256i *) in);
+    __m256i b = _mm256_loadu_si256((const __m256i *) (in + 32));
+
+    _mm256_storeu_si256((__m256i *) out, _mm256_permute4x64_epi64(
+        _mm256_packus_epi16(_mm256_and_si256(_mm256_srl_epi16(a, yshift), lo),
+                            _mm256_and_si256(_mm256_srl_epi16(b, yshift), lo)), 0xd8));
+  }
+
+  _uvc_yuv422_y_sse2(in, out, pixels, uyvy);
+}
+#endif
+
+#if defined(__aarch64__)
+static void _uvc_yuv422_y_neon(const uint8_t *in, uint8_t *out, size_t pixels, int uyvy) {
+  for (; pixels >= 16; pixels -= 16, in += 32, out += 16)
+    vst1q_u8(out, vld2q_u8(in).val[uyvy ? 1 : 0]);
+
+  _uvc_yuv422_y_c(in, out, pixels, uyvy);
+}
+#endif
+
+/* Bayer demosaic kernels.
+ *
+ * Bilinear kernels fill in one row @p cur of @p n pixels, with the rows
+ * above and below at @p up and @p dn. cur[-1] and cur[n] must be readable,
+ * the caller does the first and last column. @p g_odd tells whether green
+ * sits on the odd pixels of the row and @p red_row whether the other pixels
+ * are red (else blue). A green pixel takes the row colour from its left and
+ * right, the other colour from above and below; a red or blue pixel takes
+ * green from its four direct and the other colour from its four diagonal
+ * neighbours. Averages round to nearest, (a + b + 1) >> 1 and
+ * (a + b + c + d + 2) >> 2, so all versions are bit-identical.
+ *
+ * Superpixel kernels turn @p cells 2x2 cells of rows @p r0, @p r1 into one
+ * pixel each, averaging the two greens. Red sits at column @p rx of row
+ * @p ry in the cell.
+ */
+typedef void (_uvc_bayer_bilinear_kernel_t)(const uint8_t *up, const uint8_t *cur, const uint8_t *dn,
+                                            uint8_t *out, size_t n, int g_odd, int red_row, int bgr);
+typedef void (_uvc_bayer_superpixel_kernel_t)(const uint8_t *r0, const uint8_t *r1, uint8_t *out,
+                                              size_t cells, int rx, int ry, int bgr);
+
+/** @internal
+ * @brief Bilinear demosaic of the pixel at @p x, with left and right
+ * neighbours at @p xw and @p xe
+ */
+static inline void _uvc_bayer_bilinear_px(const uint8_t *up, const uint8_t *cur, const uint8_t *dn,
+                                          ptrdiff_t x, ptrdiff_t xw, ptrdiff_t xe, int g,
+                                          uint8_t *out, int red_row, int bgr) {
+  int gv, xv, yv;
+
+  if (g) {
+    gv = cur[x];
+    xv = (cur[xw] + cur[xe] + 1) >> 1;
+    yv = (up[x] + dn[x] + 1) >> 1;
+  } else {
+    xv = cur[x];
+    gv = (up[x] + dn[x] + cur[xw] + cur[xe] + 2) >> 2;
+    yv = (up[xw] + up[xe] + dn[xw] + dn[xe] + 2) >> 2;
+  }
+
+  out[red_row == !bgr ? 0 : 2] = xv;
+  out[1] = gv;
+  out[red_row == !bgr ? 2 : 0] = yv;
+}
+
+static void _uvc_bayer_bilinear_c(const uint8_t *up, const uint8_t *cur, const uint8_t *dn,
+                                  uint8_t *out, size_t n, int g_odd, int red_row, int bgr) {
+  ptrdiff_t x;
+
+  for (x = 0; x < (ptrdiff_t) n; x++, out += 3)
+    _uvc_bayer_bilinear_px(up, cur, dn, x, x - 1, x + 1, (int) (x & 1) == g_odd, out, red_row, bgr);
+}
+
+static void _uvc_bayer_superpixel_c(const uint8_t *r0, const uint8_t *r1, uint8_t *out,
+                                    size_t cells, int rx, int ry, int bgr) {
+  const uint8_t *rrow = ry ? r1 : r0, *brow = ry ? r0 : r1;
+  int ri = bgr ? 2 : 0, bi = bgr ? 0 : 2;
+
+  for (; cells > 0; cells--, rrow += 2, brow += 2, out += 3) {
+    out[ri] = rrow[rx];
+    out[1] = (rrow[1 - rx] + brow[rx] + 1) >> 1;
+    out[bi] = brow[1 - rx];
+  }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+/* (a + b + c + d + 2) >> 2 for 16 bytes */
+__attribute__((target("sse2")))
+static inline __m128i _uvc_avg4_sse2(__m128i a, __m128i b, __m128i c, __m128i d) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i two = _mm_set1_epi16(2);
+  __m128i lo = _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero)),
+                             _mm_add_epi16(_mm_unpacklo_epi8(c, zero), _mm_unpacklo_epi8(d, zero)));
+  __m128i hi = _mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero)),
+                             _mm_add_epi16(_mm_unpackhi_epi8(c, zero), _mm_unpackhi_epi8(d, zero)));
+
+  return _mm_packus_epi16(_mm_srli_epi16(_mm_add_epi16(lo, two), 2),
+                          _mm_srli_epi16(_mm_add_epi16(hi, two), 2));
+}
+
+/* mask ? a : b, bytewise */
+#define UVC_SSE_SELECT(mask, a, b) \
+  _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b))
+
+__attribute__((target("ssse3")))
+static void _uvc_bayer_bilinear_ssse3(const uint8_t *up, const uint8_t *cur, const uint8_t *dn,
+                                      uint8_t *out, size_t n, int g_odd, int red_row, int bgr) {
+  /* blocks of 16 keep the parity, so the green mask is fixed */
+  const __m128i gmask = _mm_set1_epi16(g_odd ? (short) 0xff00 : 0x00ff);
+  size_t x;
+
+  for (x = 0; x + 16 <= n; x += 16, out += 48) {
+    __m128i c = _mm_loadu_si128((const __m128i *) (cur + x));
+    __m128i w = _mm_loadu_si128((const __m128i *) (cur + x - 1));
+    __m128i e = _mm_loadu_si128((const __m128i *) (cur + x + 1));
+    __m128i nn = _mm_loadu_si128((const __m128i *) (up + x));
+    __m128i s = _mm_loadu_si128((const __m128i *) (dn + x));
+    __m128i diag = _uvc_avg4_sse2(_mm_loadu_si128((const __m128i *) (up + x - 1)),
+                                  _mm_loadu_si128((const __m128i *) (up + x + 1)),
+                                  _mm_loadu_si128((const __m128i *) (dn + x - 1)),
+                                  _mm_loadu_si128((const __m128i *) (dn + x + 1)));
+    __m128i G = UVC_SSE_SELECT(gmask, c, _uvc_avg4_sse2(nn, s, w, e));
+    __m128i X = UVC_SSE_SELECT(gmask, _mm_avg_epu8(w, e), c);
+    __m128i Y = UVC_SSE_SELECT(gmask, _mm_avg_epu8(nn, s), diag);
+
+    if (red_row == !bgr)
+      _uvc_store_rgb_ssse3(out, X, G, Y);
+    else
+      _uvc_store_rgb_ssse3(out, Y, G, X);
+  }
+
+  _uvc_bayer_bilinear_c(up + x, cur + x, dn + x, out, n - x, g_odd, red_row, bgr);
+}
+
+/* (a + b + c + d + 2) >> 2 for 32 bytes */
+__attribute__((target("avx2")))
+static inline __m256i _uvc_avg4_avx2(__m256i a, __m256i b, __m256i c, __m256i d) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i two = _mm256_set1_epi16(2);
+  __m256i lo = _mm256_add_epi16(_mm256_add_epi16(_mm256_unpacklo_epi8(a, zero), _mm256_unpacklo_epi8(b, zero)),
+                                _mm256_add_epi16(_mm256_unpacklo_epi8(c, zero), _mm256_unpacklo_epi8(d, zero)));
+  __m256i hi = _mm256_add_epi16(_mm256_add_epi16(_mm256_unpackhi_epi8(a, zero), _mm256_unpackhi_epi8(b, zero)),
+                                _mm256_add_epi16(_mm256_unpackhi_epi8(c, zero), _mm256_unpackhi_epi8(d, zero)));
+
+  /* unpacking and packing are both per lane, so the order survives */
+  return _mm256_packus_epi16(_mm256_srli_epi16(_mm256_add_epi16(lo, two), 2),
+                             _mm256_srli_epi16(_mm256_add_epi16(hi, two), 2));
+}
+
+__attribute__((target("avx2")))
+static void _uvc_bayer_bilinear_avx2(const uint8_t *up, const uint8_t *cur, const uint8_t *dn,
+                                     uint8_t *out, size_t n, int g_odd, int red_row, int bgr) {
+  const __m256i gmask = _mm256_set1_epi16(g_odd ? (short) 0xff00 : 0x00ff);
+  size_t x;
+
+  for (x = 0; x + 32 <= n; x += 32, out += 96) {
+    __m256i c = _mm256_loadu_si256((const __m256i *) (cur + x));
+    __m256i w = _mm256_loadu_si256((const __m256i *) (cur + x - 1));
+    __m256i e = _mm256_loadu_si256((const __m256i *) (cur + x + 1));
+    __m256i nn = _mm256_loadu_si256((const __m256i *) (up + x));
+    __m256i s = _mm256_loadu_si256((const __m256i *) (dn + x));
+    __m256i diag = _uvc_avg4_avx2(_mm256_loadu_si256((const __m256i *) (up + x - 1)),
+                                  _mm256_loadu_si256((const __m256i *) (up + x + 1)),
+                                  _mm256_loadu_si256((const __m256i *) (dn + x - 1)),
+                                  _mm256_loadu_si256((const __m256i *) (dn + x + 1)));
+    __m256i G = _mm256_blendv_epi8(_uvc_avg4_avx2(nn, s, w, e), c, gmask);
+    __m256i X = _mm256_blendv_epi8(c, _mm256_avg_epu8(w, e), gmask);
+    __m256i Y = _mm256_blendv_epi8(diag, _mm256_avg_epu8(nn, s), gmask);
+    __m256i R = red_row == !bgr ? X : Y;
+    __m256i B = red_row == !bgr ? Y : X;
+
+    _uvc_store_rgb_ssse3(out, _mm256_castsi256_si128(R), _mm256_castsi256_si128(G),
+                         _mm256_castsi256_si128(B));
+    _uvc_store_rgb_ssse3(out + 48, _mm256_extracti128_si256(R, 1), _mm256_extracti128_si256(G, 1),
+                         _mm256_extracti128_si256(B, 1));
+  }
+
+  _uvc_bayer_bilinear_ssse3(up + x, cur + x, dn + x, out, n - x, g_odd, red_row, bgr);
+}
+
+__attribute__((target("ssse3")))
+static void _uvc_bayer_superpixel_ssse3(const uint8_t *r0, const uint8_t *r1, uint8_t *out,
+                                        size_t cells, int rx, int ry, int bgr) {
+  const __m128i lo = _mm_set1_epi16(0x00ff);
+
+  for (; cells >= 16; cells -= 16, r0 += 32, r1 += 32, out += 48) {
+    __m128i a0 = _mm_loadu_si128((const __m128i *) r0);
+    __m128i a1 = _mm_loadu_si128((const __m128i *) (r0 + 16));
+    __m128i b0 = _mm_loadu_si128((const __m128i *) r1);
+    __m128i b1 = _mm_loadu_si128((const __m128i *) (r1 + 16));
+    /* p[row][column] of each cell */
+    __m128i p[2][2] = {
+      { _mm_packus_epi16(_mm_and_si128(a0, lo), _mm_and_si128(a1, lo)),
+        _mm_packus_epi16(_mm_srli_epi16(a0, 8), _mm_srli_epi16(a1, 8)) },
+      { _mm_packus_epi16(_mm_and_si128(b0, lo), _mm_and_si128(b1, lo)),
+        _mm_packus_epi16(_mm_srli_epi16(b0, 8), _mm_srli_epi16(b1, 8)) },
+    };
+    __m128i R = p[ry][rx];
+    __m128i G = _mm_avg_epu8(p[ry][1 - rx], p[1 - ry][rx]);
+    __m128i B = p[1 - ry][1 - rx];
+
+    if (bgr)
+      _uvc_store_rgb_ssse3(out, B, G, R);
+    else
+      _uvc_store_rgb_ssse3(out, R, G, B);
+  }
+
+  _uvc_bayer_superpixel_c(r0, r1, out, cells, rx, ry, bgr);
+}
+
+#undef UVC_SSE_SELECT
+#endif
+
+#if defined(__aarch64__)
+/* (a + b + c + d + 2) >> 2 for 16 bytes */
+static inline uint8x16_t _uvc_avg4_neon(uint8x16_t a, uint8x16_t b, uint8x16_t c, uint8x16_t d) {
+  uint16x8_t lo = vaddq_u16(vaddl_u8(vget_low_u8(a), vget_low_u8(b)),
+                            vaddl_u8(vget_low_u8(c), vget_low_u8(d)));
+  uint16x8_t hi = vaddq_u16(vaddl_u8(vget_high_u8(a), vget_high_u8(b)),
+                            vaddl_u8(vget_high_u8(c), vget_high_u8(d)));
+
+  return vcombine_u8(vrshrn_n_u16(lo, 2), vrshrn_n_u16(hi, 2));
+}
+
+static void _uvc_bayer_bilinear_neon(const uint8_t *up, const uint8_t *cur, const uint8_t *dn,
+                                     uint8_t *out, size_t n, int g_odd, int red_row, int bgr) {
+  const uint8x16_t gmask = vreinterpretq_u8_u16(vdupq_n_u16(g_odd ? 0xff00 : 0x00ff));
+  size_t x;
+
+  for (x = 0; x + 16 <= n; x += 16, out += 48) {
+    uint8x16_t c = vld1q_u8(cur + x);
+    uint8x16_t w = vld1q_u8(cur + x - 1);
+    uint8x16_t e = vld1q_u8(cur + x + 1);
+    uint8x16_t nn = vld1q_u8(up + x);
+    uint8x16_t s = vld1q_u8(dn + x);
+    uint8x16_t diag = _uvc_avg4_neon(vld1q_u8(up + x - 1), vld1q_u8(up + x + 1),
+                                     vld1q_u8(dn + x - 1), vld1q_u8(dn + x + 1));
+    uint8x16_t X = vbslq_u8(gmask, vrhaddq_u8(w, e), c);
+    uint8x16_t Y = vbslq_u8(gmask, vrhaddq_u8(nn, s), diag);
+    uint8x16x3_t px;
+
+    px.val[1] = vbslq_u8(gmask, c, _uvc_avg4_neon(nn, s, w, e));
+    px.val[red_row == !bgr ? 0 : 2] = X;
+    px.val[red_row == !bgr ? 2 : 0] = Y;
+    vst3q_u8(out, px);
+  }
+
+  _uvc_bayer_bilinear_c(up + x, cur + x, dn + x, out, n - x, g_odd, red_row, bgr);
+}
+
+static void _uvc_bayer_superpixel_neon(const uint8_t *r0, const uint8_t *r1, uint8_t *out,
+                                       size_t cells, int rx, int ry, int bgr) {
+  for (; cells >= 16; cells -= 16, r0 += 32, r1 += 32, out += 48) {
+    /* val[column] of each cell */
+    uint8x16x2_t p[2] = { vld2q_u8(r0), vld2q_u8(r1) };
+    uint8x16x3_t px;
+
+    px.val[bgr ? 2 : 0] = p[ry].val[rx];
+    px.val[1] = vrhaddq_u8(p[ry].val[1 - rx], p[1 - ry].val[rx]);
+    px.val[bgr ? 0 : 2] = p[1 - ry].val[1 - rx];
+    vst3q_u8(out, px);
+  }
+
+  _uvc_bayer_superpixel_c(r0, r1, out, cells, rx, ry, bgr);
+}
+#endif
+
+static _uvc_yuv422_rgb_kernel_t *_uvc_yuv422_rgb = _uvc_yuv422_rgb_c;
+static _uvc_yuv422_420_kernel_t *_uvc_yuv422_420 = _uvc_yuv422_420_c;
+static _uvc_yuv422_y_kernel_t *_uvc_yuv422_y = _uvc_yuv422_y_c;
+static _uvc_bayer_bilinear_kernel_t *_uvc_bayer_bilinear = _uvc_bayer_bilinear_c;
+static _uvc_bayer_superpixel_kernel_t *_uvc_bayer_superpixel = _uvc_bayer_superpixel_c;
+static pthread_once_t _uvc_kernels_once = PTHREAD_ONCE_INIT;
+
+/** @internal
+ * @brief Pick the fastest conversion kernels the CPU supports
+ */
+static void _uvc_select_kernels(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    _uvc_yuv422_rgb = _uvc_yuv422_rgb_avx2;
+    _uvc_yuv422_420 = _uvc_yuv422_420_avx2;
+    _uvc_yuv422_y = _uvc_yuv422_y_avx2;
+    _uvc_bayer_bilinear = _uvc_bayer_bilinear_avx2;
+    _uvc_bayer_superpixel = _uvc_bayer_superpixel_ssse3;
+  } else {
+    if (__builtin_cpu_supports("ssse3")) {
+      _uvc_yuv422_rgb = _uvc_yuv422_rgb_ssse3;
+      _uvc_bayer_bilinear = _uvc_bayer_bilinear_ssse3;
+      _uvc_bayer_superpixel = _uvc_bayer_superpixel_ssse3;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+      _uvc_yuv422_420 = _uvc_yuv422_420_sse2;
+      _uvc_yuv422_y = _uvc_yuv422_y_sse2;
+    }
+  }
+#elif defined(__aarch64__)
+  /* NEON is part of the base ARMv8-A profile */
+  _uvc_yuv422_rgb = _uvc_yuv422_rgb_neon;
+  _uvc_yuv422_420 = _uvc_yuv422_420_neon;
+  _uvc_yuv422_y = _uvc_yuv422_y_neon;
+  _uvc_bayer_bilinear = _uvc_bayer_bilinear_neon;
+  _uvc_bayer_superpixel = _uvc_bayer_superpixel_neon;
+#endif
+}
+
+/** @brief Switch the conversion kernels between SIMD and scalar
+ * @ingroup frame
+ *
+ * Conversions use the fastest SIMD kernels the CPU supports by default. The
+ * scalar kernels produce the same output; they are kept selectable to check
+ * and benchmark the SIMD ones against. Not to be called while a conversion
+ * is running.
+ *
+ * @param enable 0 for the scalar kernels, nonzero for the SIMD ones
+ */
+void uvc_set_simd(int enable) {
+  pthread_once(&_uvc_kernels_once, _uvc_select_kernels);
+
+  if (enable) {
+    _uvc_select_kernels();
+    return;
+  }
+  _uvc_yuv422_rgb = _uvc_yuv422_rgb_c;
+  _uvc_yuv422_420 = _uvc_yuv422_420_c;
+  _uvc_yuv422_y = _uvc_yuv422_y_c;
+  _uvc_bayer_bilinear = _uvc_bayer_bilinear_c;
+  _uvc_bayer_superpixel = _uvc_bayer_superpixel_c;
+}
+
+struct _uvc_yuv422_rgb_job {
+  const uint8_t *in;
+  size_t in_step;
+  uint8_t *out;
+  uint32_t width;
+  int uyvy;
+  int bgr;
+};
+
+static void _uvc_yuv422_rgb_rows(void *arg, uint32_t row_begin, uint32_t row_end) {
+  struct _uvc_yuv422_rgb_job *job = arg;
+  uint32_t row;
+
+  /* without row padding the band is one run of pixels */
+  if (job->in_step == (size_t) job->width * 2) {
+    size_t first = (size_t) row_begin * job->width;
+
+    _uvc_yuv422_rgb(job->in + first * 2, job->out + first * 3,
+                    (size_t) (row_end - row_begin) * job->width / 2, job->uyvy, job->bgr);
+    return;
+  }
+
+  for (row = row_begin; row < row_end; row++)
+    _uvc_yuv422_rgb(job->in + (size_t) row * job->in_step, job->out + (size_t) row * job->width * 3,
+                    job->width / 2, job->uyvy, job->bgr);
+}
+
+/** @internal
+ * @brief Convert a packed 4:2:2 frame to 24-bit RGB/BGR
+ *
+ * Converts all rows, or as many as the input frame holds.
+ */
+static void _uvc_convert_yuv422_rgb(uvc_frame_t *in, uvc_frame_t *out, int uyvy, int bgr) {
+  size_t in_step = in->step >= in->width * 2 ? in->step : (size_t) in->width * 2;
+  struct _uvc_yuv422_rgb_job job = { in->data, in_step, out->data, in->width, uyvy, bgr };
+  uint32_t rows = in->height;
+
+  if (in->width == 0)
+    return;
+  if (rows > in->data_bytes / in_step)
+    rows = in->data_bytes / in_step;
+
+  pthread_once(&_uvc_kernels_once, _uvc_select_kernels);
+  _uvc_parallel_rows(_uvc_yuv422_rgb_rows, &job, rows, in->width);
+}
+
+/** @brief Convert a frame from YUYV to RGB
+ * @ingroup frame
+ *
+ * @param in YUYV frame
+ * @param out RGB frame
+ */
+uvc_error_t uvc_yuyv2rgb(uvc_frame_t *in, uvc_frame_t *out) {
+  if (in->frame_format != UVC_FRAME_FORMAT_YUYV)
+    return UVC_ERROR_INVALID_PARAM;
+
+  if (uvc_ensure_frame_size(out, in->width * in->height * 3) < 0)
+    return UVC_ERROR_NO_MEM;
+
+  out->width = in->width;
+  out->height = in->height;
+  out->frame_format = UVC_FRAME_FORMAT_RGB;
+  out->step = in->width * 3;
+  out->sequence = in->sequence;
+  out->capture_time = in->capture_time;
+  out->arrival_time = in->arrival_time;
+  out->arrival_ns = in->arrival_ns;
+  out->errors = in->errors;
+  out->pts = in->pts;
+  out->scr = in->scr;
+  out->sof = in->sof;
+  out->has_pts = in->has_pts;
+  out->has_scr = in->has_scr;
+  out->source = in->source;
+
+  _uvc_convert_yuv422_rgb(in, out, 0, 0);
+
+  return UVC_SUCCESS;
+}
+
+
+/** @brief Convert a frame from YUYV to BGR
+ * @ingroup frame
+ *
+ * @param in YUYV frame
+ * @param out BGR frame
+ */
+uvc_error_t uvc_yuyv2bgr(uvc_frame_t *in, uvc_frame_t *out) {
+  if (in->frame_format != UVC_FRAME_FORMAT_YUYV)
+    return UVC_ERROR_INVALID_PARAM;
+
+  if (uvc_ensure_frame_size(out, in->width * in->height * 3) < 0)
+    return UVC_ERROR_NO_MEM;
+
+  out->width = in->width;
+  out->height = in->height;
+  out->frame_format = UVC_FRAME_FORMAT_BGR;
+  out->step = in->width * 3;
+  out->sequence = in->sequence;
+  out->capture_time = in->capture_time;
+  out->arrival_time = in->arrival_time;
+  out->arrival_ns = in->arrival_ns;
+  out->errors = in->errors;
+  out->pts = in->pts;
+  out->scr = in->scr;
+  out->sof = in->sof;
+  out->has_pts = in->has_pts;
+  out->has_scr = in->has_scr;
+  out->source = in->source;
+
+  _uvc_convert_yuv422_rgb(in, out, 0, 1);
+
+  return UVC_SUCCESS;
+}
+
+struct _uvc_yuv422_y_job {
+  const uint8_t *in;
+  size_t in_step;
+  uint8_t *out;
+  uint32_t width;
+  int uyvy;
+};
+
+static void _uvc_yuv422_y_rows(void *arg, uint32_t row_begin, uint32_t row_end) {
+  struct _uvc_yuv422_y_job *job = arg;
+  uint32_t row;
+
+  /* without row padding the band is one run of pixels */
+  if (job->in_step == (size_t) job->width * 2) {
+    _uvc_yuv422_y(job->in + (size_t) row_begin * job->in_step, job->out + (size_t) row_begin * job->width,
+                  (size_t) (row_end - row_begin) * job->width, job->uyvy);
+    return;
+  }
+
+  for (row = row_begin; row < row_end; row++)
+    _uvc_yuv422_y(job->in + (size_t) row * job->in_step, job->out + (size_t) row * job->width,
+                  job->width, job->uyvy);
+}
+
+/** @internal
+ * @brief Copy the luma of a packed 4:2:2 frame into a GRAY8 frame
+ *
+ * Converts all rows, or as many as the input frame holds; the rows it
+ * doesn't hold are black.
+ */
+static uvc_error_t _uvc_convert_yuv422_y(uvc_frame_t *in, uvc_frame_t *out, int uyvy) {
+  struct _uvc_yuv422_y_job job;
+  size_t in_step = in->step >= in->width * 2 ? in->step : (size_t) in->width * 2;
+  uint32_t rows = in->height;
+
+  if (uvc_ensure_frame_size(out, in->width * in->height) < 0)
+    return UVC_ERROR_NO_MEM;
+
+  out->width = in->width;
+  out->height = in->height;
+  out->frame_format = UVC_FRAME_FORMAT_GRAY8;
+  out->step = in->width;
+  out->sequence = in->sequence;
+  out->capture_time = in->capture_time;
+  out->arrival_time = in->arrival_time;
+  out->arrival_ns = in->arrival_ns;
+  out->errors = in->errors;
+  out->pts = in->pts;
+  out->scr = in->scr;
+  out->sof = in->sof;
+  out->has_pts = in->has_pts;
+  out->has_scr = in->has_scr;
+  out->source = in->source;
+
+  if (in->width == 0)
+    return UVC_SUCCESS;
+  if (rows > in->data_bytes / in_step)
+    rows = in->data_bytes / in_step;
+  if (rows < in->height)
+    memset((uint8_t *) out->data + (size_t) rows * in->width, 0, (size_t) (in->height - rows) * in->width);
+
+  job.in = in->data;
+  job.in_step = in_step;
+  job.out = out->data;
+  job.width = in->width;
+  job.uyvy = uyvy;
+
+  pthread_once(&_uvc_kernels_once, _uvc_select_kernels);
+  _uvc_parallel_rows(_uvc_yuv422_y_rows, &job, rows, in->width);
+
+  return UVC_SUCCESS;
+}
+
+/** @brief Convert a frame from YUYV to Y (GRAY8)
+ * @ingroup frame
+ *
+ * @param in YUYV frame
+ * @param out GRAY8 frame
+ */
+uvc_error_t uvc_yuyv2y(uvc_frame_t *in, uvc_frame_t *out) {
+  if (in->frame_format != UVC_FRAME_FORMAT_YUYV)
+    return UVC_ERROR_INVALID_PARAM;
+
+  return _uvc_convert_yuv422_y(in, out, 0);
+}
+
+/** @brief Convert a frame from UYVY to Y (GRAY8)
+ * @ingroup frame
+ *
+ * @param in UYVY frame
+ * @param out GRAY8 frame
+ */
+uvc_error_t uvc_uyvy2y(uvc_frame_t *in, uvc_frame_t *out) {
+  if (in->frame_format != UVC_FRAME_FORMAT_UYVY)
+    return UVC_ERROR_INVALID_PARAM;
+
+  return _uvc_convert_yuv422_y(in, out, 1);
+}
+
+/** @brief Extract the luma of a frame as GRAY8
+ * @ingroup frame
+ *
+ * @param in YUYV, UYVY or GRAY8 frame
+ * @param out GRAY8 frame
+ */
+uvc_error_t uvc_any2y(uvc_frame_t *in, uvc_frame_t *out) {
+  switch (in->frame_format) {
+    case UVC_FRAME_FORMAT_YUYV:
+      return uvc_yuyv2y(in, out);
+    case UVC_FRAME_FORMAT_UYVY:
+      return uvc_uyvy2y(in, out);
+    case UVC_FRAME_FORMAT_GRAY8:
+      return uvc_duplicate_frame(in, out);
+    default:
+      return UVC_ERROR_NOT_SUPPORTED;
+  }
+}
+
+#define IYUYV2UV(pyuv, puv) { \
+    (puv)[0] = (pyuv[1]); \
+    }
+
+/** @brief Convert a frame from YUYV to UV (GRAY8)
+ * @ingroup frame
+ *
+ * @param in YUYV frame
+ * @param out GRAY8 frame
+ */
+uvc_error_t uvc_yuyv2uv(uvc_frame_t *in, uvc_frame_t *out) {
+  if (in->frame_format != UVC_FRAME_FORMAT_YUYV)
+    return UVC_ERROR_INVALID_PARAM;
+
+  if (uvc_ensure_frame_size(out, in->width * in->height) < 0)
+    return UVC_ERROR_NO_MEM;
+
+  out->width = in->width;
+  out->height = in->height;
+  out->frame_format = UVC_FRAME_FORMAT_GRAY8;
+  out->step = in->width;
+  out->sequence = in->sequence;
+  out->capture_time = in->capture_time;
+  out->arrival_time = in->arrival_time;
+  out->arrival_ns = in->arrival_ns;
+  out->errors = in->errors;
+  out->pts = in->pts;
+  out->scr = in->scr;
+  out->sof = in->sof;
+  out->has_pts = in->has_pts;
+  out->has_scr = in->has_scr;
+  out->source = in->source;
+
+  uint8_t *pyuv = in->data;
+  uint8_t *puv = out->data;
+  uint8_t *puv_end = puv + out->data_bytes;
+
+  while (puv < puv_end) {
+    IYUYV2UV(pyuv, puv);
+
+    puv += 1;
+    pyuv += 2;
+  }
+
+  return UVC_SUCCESS;
+}
+
+
+/** @brief Convert a frame from UYVY to RGB
+ * @ingroup frame
+ * @param ini UYVY frame
+ * @param out RGB frame
+ */
+uvc_error_t uvc_uyvy2rgb(uvc_frame_t *in, uvc_frame_t *out) {
+  if (in->frame_format != UVC_FRAME_FORMAT_UYVY)
+    return UVC_ERROR_INVALID_PARAM;
+
+  if (uvc_ensure_frame_size(out, in->width * in->height * 3) < 0)
+    return UVC_ERROR_NO_MEM;
+
+  out->width = in->width;
+  out->height = in->height;
+  out->frame_format = UVC_FRAME_FORMAT_RGB;
+  out->step = in->width *3;
+  out->sequence = in->sequence;
+  out->capture_time = in->capture_time;
+  out->arrival_time = in->arrival_time;
+  out->arrival_ns = in->arrival_ns;
+  out->errors = in->errors;
+  out->pts = in->pts;
+  out->scr = in->scr;
+  out->sof = in->sof;
+  out->has_pts = in->has_pts;
+  out->has_scr = in->has_scr;
+  out->source = in->source;
+
+  _uvc_convert_yuv422_rgb(in, out, 1, 0);
+
+  return UVC_SUCCESS;
+}
+
+
+/** @brief Convert a frame from UYVY to BGR
+ * @ingroup frame
+ * @param ini UYVY frame
+ * @param out BGR frame
+ */
+uvc_error_t uvc_uyvy2bgr(uvc_frame_t *in, uvc_frame_t *out) {
+  if (in->frame_format != UVC_FRAME_FORMAT_UYVY)
+    return UVC_ERROR_INVALID_PARAM;
+
+  if (uvc_ensure_frame_size(out, in->width * in->height * 3) < 0)
+    return UVC_ERROR_NO_MEM;
+
+  out->width = in->width;
+  out->height = in->height;
+  out->frame_format = UVC_FRAME_FORMAT_BGR;
+  out->step = in->width *3;
+  out->sequence = in->sequence;
+  out->capture_time = in->capture_time;
+  out->arrival_time = in->arrival_time;
+  out->arrival_ns = in->arrival_ns;
+  out->errors = in->errors;
+  out->pts = in->pts;
+  out->scr = in->scr;
+  out->sof = in->sof;
+  out->has_pts = in->has_pts;
+  out->has_scr = in->has_scr;
+  out->source = in->source;
+
+  _uvc_convert_yuv422_rgb(in, out, 1, 1);
+
+  return UVC_SUCCESS;
+}
+
+/** @brief Convert a frame to RGB
+ * @ingroup frame
+ *
+ * @param in non-RGB frame
+ * @param out RGB frame
+ */
+uvc_error_t uvc_any2rgb(uvc_frame_t *in, uvc_frame_t *out) {
+  switch (in->frame_format) {
+    case UVC_FRAME_FORMAT_YUYV:
+      return uvc_yuyv2rgb(in, out);
+    case UVC_FRAME_FORMAT_UYVY:
+      return uvc_uyvy2rgb(in, out);
+    case UVC_FRAME_FORMAT_RGB:
+      return uvc_duplicate_frame(in, out);
+    case UVC_FRAME_FORMAT_BA81:
+    case UVC_FRAME_FORMAT_SGRBG8:
+    case UVC_FRAME_FORMAT_SGBRG8:
+    case UVC_FRAME_FORMAT_SRGGB8:
+    case UVC_FRAME_FORMAT_SBGGR8:
+      return uvc_bayer2rgb(in, out, UVC_DEMOSAIC_BILINEAR);
+    default:
+      return UVC_ERROR_NOT_SUPPORTED;
+  }
+}
+
+/** @brief Convert a frame to BGR
+ * @ingroup frame
+ *
+ * @param in non-BGR frame
+ * @param out BGR frame
+ */
+uvc_error_t uvc_any2bgr(uvc_frame_t *in, uvc_frame_t *out) {
+  switch (in->frame_format) {
+    case UVC_FRAME_FORMAT_YUYV:
+      return uvc_yuyv2bgr(in, out);
+    case UVC_FRAME_FORMAT_UYVY:
+      return uvc_uyvy2bgr(in, out);
+    case UVC_FRAME_FORMAT_BGR:
+      return uvc_duplicate_frame(in, out);
+    case UVC_FRAME_FORMAT_BA81:
+    case UVC_FRAME_FORMAT_SGRBG8:
+    case UVC_FRAME_FORMAT_SGBRG8:
+    case UVC_FRAME_FORMAT_SRGGB8:
+    case UVC_FRAME_FORMAT_SBGGR8:
+      return uvc_bayer2bgr(in, out, UVC_DEMOSAIC_BILINEAR);
+    default:
+      return UVC_ERROR_NOT_SUPPORTED;
+  }
+}
+
+
+struct _uvc_yuv422_420_job {
+  const uint8_t *in;
+  size_t in_step;
+  uint32_t height;
+  size_t pairs;
+  int uyvy;
+  uint8_t *y, *u, *v;
+  size_t y_stride, u_stride, v_stride;
+};
+
+/* rows are chroma rows, each covering two input rows */
+static void _uvc_yuv422_420_rows(void *arg, uint32_t row_begin, uint32_t row_end) {
+  struct _uvc_yuv422_420_job *job = arg;
+  uint32_t row;
+
+  for (row = row_begin; row < row_end; row++) {
+    size_t r0 = (size_t) row * 2;
+    /* an odd last input row pairs up with itself */
+    size_t r1 = r0 + 1 < job->height ? r0 + 1 : r0;
+
+    _uvc_yuv422_420(job->in + r0 * job->in_step, job->in + r1 * job->in_step,
+                    job->y + r0 * job->y_stride, job->y + r1 * job->y_stride,
+                    job->u + row * job->u_stride, job->v ? job->v + row * job->v_stride : NULL,
+                    job->pairs, job->uyvy);
+  }
+}
+
+/** @internal
+ * @brief Convert a packed 4:2:2 frame to planar 4:2:0
+ *
+ * Converts all rows, or as many as the input frame holds. NV12 if @p v is
+ * NULL, I420 otherwise.
+ */
+static uvc_error_t _uvc_convert_yuv422_420(uvc_frame_t *in, int uyvy,
+                                           uint8_t *y, size_t y_stride,
+                                           uint8_t *u, size_t u_stride,
+                                           uint8_t *v, size_t v_stride) {
+  struct _uvc_yuv422_420_job job;
+  size_t in_step = in->step >= in->width * 2 ? in->step : (size_t) in->width * 2;
+  uint32_t height = in->height;
+
+  if (in->width == 0 || in->width % 2 || !y || !u)
+    return UVC_ERROR_INVALID_PARAM;
+  if (y_stride < in->width || u_stride < (v ? in->width / 2 : in->width) ||
+      (v && v_stride < in->width / 2))
+    return UVC_ERROR_INVALID_PARAM;
+
+  if (height > in->data_bytes / in_step)
+    height = in->data_bytes / in_step;
+
+  job.in = in->data;
+  job.in_step = in_step;
+  job.height = height;
+  job.pairs = in->width / 2;
+  job.uyvy = uyvy;
+  job.y = y;
+  job.u = u;
+  job.v = v;
+  job.y_stride = y_stride;
+  job.u_stride = u_stride;
+  job.v_stride = v_stride;
+
+  pthread_once(&_uvc_kernels_once, _uvc_select_kernels);
+  _uvc_parallel_rows(_uvc_yuv422_420_rows, &job, (height + 1) / 2, (size_t) in->width * 2);
 
   return UVC_SUCCESS;
 }
 
-#define IYUYV2Y(pyuv, py) { \
-    (py)[0] = (pyuv[0]); \
+/** @brief Convert a frame from YUYV to NV12
+ * @ingroup frame
+ *
+ * Chroma of each two rows is averaged. The planes are caller owned: a
+ * width x height luma plane and a width x (height + 1) / 2 plane of
+ * interleaved U, V samples.
+ *
+ * @param in YUYV frame of even width
+ * @param y Luma plane
+ * @param y_stride Bytes per luma row, at least width
+ * @param uv Chroma plane
+ * @param uv_stride Bytes per chroma row, at least width
+ */
+uvc_error_t uvc_yuyv2nv12(uvc_frame_t *in, uint8_t *y, size_t y_stride, uint8_t *uv, size_t uv_stride) {
+  if (in->frame_format != UVC_FRAME_FORMAT_YUYV)
+    return UVC_ERROR_INVALID_PARAM;
+
+  return _uvc_convert_yuv422_420(in, 0, y, y_stride, uv, uv_stride, NULL, 0);
+}
+
+/** @brief Convert a frame from UYVY to NV12
+ * @ingroup frame
+ *
+ * @see uvc_yuyv2nv12
+ * @param in UYVY frame of even width
+ */
+uvc_error_t uvc_uyvy2nv12(uvc_frame_t *in, uint8_t *y, size_t y_stride, uint8_t *uv, size_t uv_stride) {
+  if (in->frame_format != UVC_FRAME_FORMAT_UYVY)
+    return UVC_ERROR_INVALID_PARAM;
+
+  return _uvc_convert_yuv422_420(in, 1, y, y_stride, uv, uv_stride, NULL, 0);
+}
+
+/** @brief Convert a frame to NV12
+ * @ingroup frame
+ *
+ * @see uvc_yuyv2nv12
+ * @param in YUYV or UYVY frame
+ */
+uvc_error_t uvc_any2nv12(uvc_frame_t *in, uint8_t *y, size_t y_stride, uint8_t *uv, size_t uv_stride) {
+  switch (in->frame_format) {
+    case UVC_FRAME_FORMAT_YUYV:
+      return uvc_yuyv2nv12(in, y, y_stride, uv, uv_stride);
+    case UVC_FRAME_FORMAT_UYVY:
+      return uvc_uyvy2nv12(in, y, y_stride, uv, uv_stride);
+    default:
+      return UVC_ERROR_NOT_SUPPORTED;
+  }
+}
+
+/** @brief Convert a frame from YUYV to I420
+ * @ingroup frame
+ *
+ * Chroma of each two rows is averaged. The planes are caller owned: a
+ * width x height luma plane and two width / 2 x (height + 1) / 2 chroma
+ * planes.
+ *
+ * @param in YUYV frame of even width
+ * @param y Luma plane
+ * @param y_stride Bytes per luma row, at least width
+ * @param u U plane
+ * @param u_stride Bytes per U row, at least width / 2
+ * @param v V plane
+ * @param v_stride Bytes per V row, at least width / 2
+ */
+uvc_error_t uvc_yuyv2i420(uvc_frame_t *in, uint8_t *y, size_t y_stride,
+                          uint8_t *u, size_t u_stride, uint8_t *v, size_t v_stride) {
+  if (in->frame_format != UVC_FRAME_FORMAT_YUYV || !v)
+    return UVC_ERROR_INVALID_PARAM;
+
+  return _uvc_convert_yuv422_420(in, 0, y, y_stride, u, u_stride, v, v_stride);
+}
+
+/** @brief Convert a frame from UYVY to I420
+ * @ingroup frame
+ *
+ * @see uvc_yuyv2i420
+ * @param in UYVY frame of even width
+ */
+uvc_error_t uvc_uyvy2i420(uvc_frame_t *in, uint8_t *y, size_t y_stride,
+                          uint8_t *u, size_t u_stride, uint8_t *v, size_t v_stride) {
+  if (in->frame_format != UVC_FRAME_FORMAT_UYVY || !v)
+    return UVC_ERROR_INVALID_PARAM;
+
+  return _uvc_convert_yuv422_420(in, 1, y, y_stride, u, u_stride, v, v_stride);
+}
+
+/** @brief Convert a frame to I420
+ * @ingroup frame
+ *
+ * @see uvc_yuyv2i420
+ * @param in YUYV or UYVY frame
+ */
+uvc_error_t uvc_any2i420(uvc_frame_t *in, uint8_t *y, size_t y_stride,
+                         uint8_t *u, size_t u_stride, uint8_t *v, size_t v_stride) {
+  switch (in->frame_format) {
+    case UVC_FRAME_FORMAT_YUYV:
+      return uvc_yuyv2i420(in, y, y_stride, u, u_stride, v, v_stride);
+    case UVC_FRAME_FORMAT_UYVY:
+      return uvc_uyvy2i420(in, y, y_stride, u, u_stride, v, v_stride);
+    default:
+      return UVC_ERROR_NOT_SUPPORTED;
+  }
+}
+
+
+/** @internal
+ * @brief Position of red in the 2x2 cell of a Bayer format
+ * @return 0 if @p format isn't a known Bayer layout
+ */
+static int _uvc_bayer_layout(enum uvc_frame_format format, int *rx, int *ry) {
+  switch (format) {
+    case UVC_FRAME_FORMAT_SRGGB8:
+      *rx = 0, *ry = 0;
+      return 1;
+    case UVC_FRAME_FORMAT_SGRBG8:
+      *rx = 1, *ry = 0;
+      return 1;
+    case UVC_FRAME_FORMAT_SGBRG8:
+      *rx = 0, *ry = 1;
+      return 1;
+    case UVC_FRAME_FORMAT_SBGGR8:
+    case UVC_FRAME_FORMAT_BA81:
+      /* BA81 is the V4L2 name of SBGGR8 */
+      *rx = 1, *ry = 1;
+      return 1;
+    default:
+      /* BY8 doesn't tell the order of its mosaic */
+      return 0;
+  }
+}
+
+struct _uvc_bayer_job {
+  const uint8_t *in;
+  size_t in_step;
+  uint8_t *out;
+  size_t out_step;
+  uint32_t width;
+  uint32_t height;
+  int rx, ry;
+  int bgr;
+};
+
+/* mirror an index at most 2 outside 0 .. n - 1 back into range, keeping
+ * its place in the mosaic; twice over for n = 2 */
+static inline ptrdiff_t _uvc_bayer_mirror(ptrdiff_t i, ptrdiff_t n) {
+  if (i < 0)
+    i = -i;
+  if (i >= n)
+    i = 2 * (n - 1) - i;
+  return i < 0 ? -i : i;
+}
+
+static void _uvc_bayer_bilinear_rows(void *arg, uint32_t row_begin, uint32_t row_end) {
+  struct _uvc_bayer_job *job = arg;
+  ptrdiff_t w = job->width;
+  uint32_t row;
+
+  for (row = row_begin; row < row_end; row++) {
+    const uint8_t *cur = job->in + row * job->in_step;
+    const uint8_t *up = job->in + _uvc_bayer_mirror((ptrdiff_t) row - 1, job->height) * job->in_step;
+    const uint8_t *dn = job->in + _uvc_bayer_mirror((ptrdiff_t) row + 1, job->height) * job->in_step;
+    uint8_t *out = job->out + row * job->out_step;
+    int red_row = (int) (row & 1) == job->ry;
+    /* green shares the row with red on the other column, with blue on the same */
+    int g_even = red_row ? job->rx : !job->rx;
+
+    _uvc_bayer_bilinear_px(up, cur, dn, 0, 1, 1, g_even, out, red_row, job->bgr);
+    _uvc_bayer_bilinear(up + 1, cur + 1, dn + 1, out + 3, w - 2, g_even, red_row, job->bgr);
+    _uvc_bayer_bilinear_px(up, cur, dn, w - 1, w - 2, w - 2, !g_even, out + (w - 1) * 3, red_row, job->bgr);
+  }
+}
+
+/* Edge-aware demosaic in two passes over the rows. The first fills in green
+ * along the direction of the smaller gradient (Hamilton-Adams), the second
+ * interpolates red and blue as differences to green, which keeps colour
+ * fringes off edges. The first pass writes green straight into the output
+ * for the second to read. */
+static void _uvc_bayer_edge_green_rows(void *arg, uint32_t row_begin, uint32_t row_end) {
+  struct _uvc_bayer_job *job = arg;
+  ptrdiff_t w = job->width, h = job->height;
+  uint32_t row;
+  ptrdiff_t x;
+
+  for (row = row_begin; row < row_end; row++) {
+    const uint8_t *r[5];
+    uint8_t *out = job->out + row * job->out_step;
+    int red_row = (int) (row & 1) == job->ry;
+    int g_even = red_row ? job->rx : !job->rx;
+    int i;
+
+    /* rows - 2 .. + 2 */
+    for (i = 0; i < 5; i++)
+      r[i] = job->in + _uvc_bayer_mirror((ptrdiff_t) row + i - 2, h) * job->in_step;
+
+    for (x = 0; x < w; x++) {
+      ptrdiff_t xw = x - 1, xe = x + 1, xww = x - 2, xee = x + 2;
+      int c = r[2][x];
+      int lh, lv, gh, gv, eh, ev, g;
+
+      if ((int) (x & 1) != g_even) {
+        out[x * 3 + 1] = c;
+        continue;
+      }
+
+      if (x < 2 || x >= w - 2) {
+        xw = _uvc_bayer_mirror(xw, w), xe = _uvc_bayer_mirror(xe, w);
+        xww = _uvc_bayer_mirror(xww, w), xee = _uvc_bayer_mirror(xee, w);
+      }
+
+      /* second derivative of the own colour corrects the green average */
+      lh = 2 * c - r[2][xww] - r[2][xee];
+      lv = 2 * c - r[0][x] - r[4][x];
+      gh = abs(r[2][xw] - r[2][xe]) + abs(lh);
+      gv = abs(r[1][x] - r[3][x]) + abs(lv);
+      eh = 2 * (r[2][xw] + r[2][xe]) + lh;
+      ev = 2 * (r[1][x] + r[3][x]) + lv;
+
+      if (gh < gv)
+        g = (eh + 2) >> 2;
+      else if (gv < gh)
+        g = (ev + 2) >> 2;
+      else
+        g = (eh + ev + 4) >> 3;
+
+      out[x * 3 + 1] = sat(g);
+    }
+  }
+}
+
+static void _uvc_bayer_edge_color_rows(void *arg, uint32_t row_begin, uint32_t row_end) {
+  struct _uvc_bayer_job *job = arg;
+  ptrdiff_t w = job->width, h = job->height;
+  uint32_t row;
+  ptrdiff_t x;
+
+  for (row = row_begin; row < row_end; row++) {
+    ptrdiff_t rn = _uvc_bayer_mirror((ptrdiff_t) row - 1, h), rs = _uvc_bayer_mirror((ptrdiff_t) row + 1, h);
+    const uint8_t *cur = job->in + row * job->in_step;
+    const uint8_t *up = job->in + rn * job->in_step, *dn = job->in + rs * job->in_step;
+    uint8_t *out = job->out + row * job->out_step;
+    const uint8_t *gup = job->out + rn * job->out_step + 1, *gdn = job->out + rs * job->out_step + 1;
+    const uint8_t *gcur = out + 1;
+    int red_row = (int) (row & 1) == job->ry;
+    int g_even = red_row ? job->rx : !job->rx;
+    int xi = red_row == !job->bgr ? 0 : 2;
+
+    for (x = 0; x < w; x++) {
+      ptrdiff_t xw = x - 1, xe = x + 1;
+      int g = gcur[x * 3];
+      int xv, yv;
+
+      if (x == 0 || x == w - 1)
+        xw = _uvc_bayer_mirror(xw, w), xe = _uvc_bayer_mirror(xe, w);
+
+      if ((int) (x & 1) != g_even) {
+        /* row colour from the left and right, the other from above and below */
+        xv = g + ((cur[xw] - gcur[xw * 3]) + (cur[xe] - gcur[xe * 3])) / 2;
+        yv = g + ((up[x] - gup[x * 3]) + (dn[x] - gdn[x * 3])) / 2;
+      } else {
+        xv = cur[x];
+        yv = g + ((up[xw] - gup[xw * 3]) + (up[xe] - gup[xe * 3]) +
+                  (dn[xw] - gdn[xw * 3]) + (dn[xe] - gdn[xe * 3])) / 4;
+      }
+
+      out[x * 3 + xi] = sat(xv);
+      out[x * 3 + 2 - xi] = sat(yv);
     }
+  }
+}
 
-/** @brief Convert a frame from YUYV to Y (GRAY8)
- * @ingroup frame
- *
- * @param in YUYV frame
- * @param out GRAY8 frame
+static void _uvc_bayer_superpixel_rows(void *arg, uint32_t row_begin, uint32_t row_end) {
+  struct _uvc_bayer_job *job = arg;
+  uint32_t row;
+
+  for (row = row_begin; row < row_end; row++) {
+    const uint8_t *r0 = job->in + (size_t) row * 2 * job->in_step;
+
+    _uvc_bayer_superpixel(r0, r0 + job->in_step, job->out + row * job->out_step,
+                          job->width / 2, job->rx, job->ry, job->bgr);
+  }
+}
+
+/** @internal
+ * @brief Demosaic a Bayer frame to 24-bit RGB/BGR
  */
-uvc_error_t uvc_yuyv2y(uvc_frame_t *in, uvc_frame_t *out) {
-  if (in->frame_format != UVC_FRAME_FORMAT_YUYV)
+static uvc_error_t _uvc_convert_bayer(uvc_frame_t *in, uvc_frame_t *out,
+                                      enum uvc_demosaic_method method, int bgr) {
+  struct _uvc_bayer_job job;
+  size_t in_step = in->step >= in->width ? in->step : in->width;
+  uint32_t out_width = in->width, out_height = in->height;
+  uint32_t height = in->height;
+
+  if (!_uvc_bayer_layout(in->frame_format, &job.rx, &job.ry))
+    return UVC_ERROR_NOT_SUPPORTED;
+
+  if (in->width < 2 || in->height < 2 || in->width % 2 || in->height % 2)
     return UVC_ERROR_INVALID_PARAM;
 
-  if (uvc_ensure_frame_size(out, in->width * in->height) < 0)
+  /* whole cells of rows only */
+  if (height > in->data_bytes / in_step)
+    height = (uint32_t) (in->data_bytes / in_step) & ~1u;
+  if (height < 2)
+    return UVC_ERROR_INVALID_PARAM;
+
+  if (method == UVC_DEMOSAIC_SUPERPIXEL) {
+    out_width /= 2;
+    out_height /= 2;
+  } else if (method != UVC_DEMOSAIC_BILINEAR && method != UVC_DEMOSAIC_EDGE_AWARE) {
+    return UVC_ERROR_INVALID_PARAM;
+  }
+
+  if (uvc_ensure_frame_size(out, (size_t) out_width * out_height * 3) < 0)
     return UVC_ERROR_NO_MEM;
 
-  out->width = in->width;
-  out->height = in->height;
-  out->frame_format = UVC_FRAME_FORMAT_GRAY8;
-  out->step = in->width;
+  out->width = out_width;
+  out->height = out_height;
+  out->frame_format = bgr ? UVC_FRAME_FORMAT_BGR : UVC_FRAME_FORMAT_RGB;
+  out->step = out_width * 3;
   out->sequence = in->sequence;
   out->capture_time = in->capture_time;
+  out->arrival_time = in->arrival_time;
+  out->arrival_ns = in->arrival_ns;
+  out->errors = in->errors;
+  out->pts = in->pts;
+  out->scr = in->scr;
+  out->sof = in->sof;
+  out->has_pts = in->has_pts;
+  out->has_scr = in->has_scr;
   out->source = in->source;
 
-  uint8_t *pyuv = in->data;
-  uint8_t *py = out->data;
-  uint8_t *py_end = py + out->data_bytes;
+  job.in = in->data;
+  job.in_step = in_step;
+  job.out = out->data;
+  job.out_step = out->step;
+  job.width = in->width;
+  job.height = height;
+  job.bgr = bgr;
 
-  while (py < py_end) {
-    IYUYV2Y(pyuv, py);
+  pthread_once(&_uvc_kernels_once, _uvc_select_kernels);
 
-    py += 1;
-    pyuv += 2;
+  switch (method) {
+    case UVC_DEMOSAIC_BILINEAR:
+      _uvc_parallel_rows(_uvc_bayer_bilinear_rows, &job, height, in->width);
+      break;
+    case UVC_DEMOSAIC_EDGE_AWARE:
+      /* the second pass reads green of the rows around it */
+      _uvc_parallel_rows(_uvc_bayer_edge_green_rows, &job, height, in->width);
+      _uvc_parallel_rows(_uvc_bayer_edge_color_rows, &job, height, in->width);
+      break;
+    case UVC_DEMOSAIC_SUPERPIXEL:
+      _uvc_parallel_rows(_uvc_bayer_superpixel_rows, &job, height / 2, in->width * 2);
+      break;
   }
 
   return UVC_SUCCESS;
 }
 
-#define IYUYV2UV(pyuv, puv) { \
-    (puv)[0] = (pyuv[1]); \
+/** @brief Demosaic a raw Bayer frame to RGB
+ * @ingroup frame
+ *
+ * Handles SRGGB8, SGRBG8, SGBRG8, SBGGR8 and BA81. BY8 doesn't state the
+ * order of its mosaic and is not supported.
+ *
+ * @param in Bayer frame of even width and height
+ * @param out RGB frame, half the width and height for UVC_DEMOSAIC_SUPERPIXEL
+ * @param method Demosaic algorithm
+ */
+uvc_error_t uvc_bayer2rgb(uvc_frame_t *in, uvc_frame_t *out, enum uvc_demosaic_method method) {
+  return _uvc_convert_bayer(in, out, method, 0);
+}
+
+/** @brief Demosaic a raw Bayer frame to BGR
+ * @ingroup frame
+ *
+ * @see uvc_bayer2rgb
+ * @param in Bayer frame of even width and height
+ * @param out BGR frame, half the width and height for UVC_DEMOSAIC_SUPERPIXEL
+ * @param method Demosaic algorithm
+ */
+uvc_error_t uvc_bayer2bgr(uvc_frame_t *in, uvc_frame_t *out, enum uvc_demosaic_method method) {
+  return _uvc_convert_bayer(in, out, method, 1);
+}
+
+/* DHT segment with the example tables of ITU-T T.81 Annex K.3 */
+static const uint8_t _uvc_mjpeg_dht[UVC_MJPEG_DHT_BYTES] = {
+  0xff, 0xc4, 0x01, 0xa2,
+  /* luminance DC */
+  0x00,
+  0x00, 0x01, 0x05, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b,
+  /* luminance AC */
+  0x10,
+  0x00, 0x02, 0x01, 0x03, 0x03, 0x02, 0x04, 0x03, 0x05, 0x05, 0x04, 0x04, 0x00, 0x00, 0x01, 0x7d,
+  0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06,
+  0x13, 0x51, 0x61, 0x07, 0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08,
+  0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0, 0x24, 0x33, 0x62, 0x72,
+  0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+  0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45,
+  0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59,
+  0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74, 0x75,
+  0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+  0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3,
+  0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6,
+  0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9,
+  0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+  0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4,
+  0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa,
+  /* chrominance DC */
+  0x01,
+  0x00, 0x03, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b,
+  /* chrominance AC */
+  0x11,
+  0x00, 0x02, 0x01, 0x02, 0x04, 0x04, 0x03, 0x04, 0x07, 0x05, 0x04, 0x04, 0x00, 0x01, 0x02, 0x77,
+  0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41,
+  0x51, 0x07, 0x61, 0x71, 0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91,
+  0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0, 0x15, 0x62, 0x72, 0xd1,
+  0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+  0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44,
+  0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58,
+  0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74,
+  0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+  0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a,
+  0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4,
+  0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7,
+  0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+  0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4,
+  0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa,
+};
+
+/** @internal
+ * @brief Find where the DHT segment of an MJPEG frame has to go
+ *
+ * Walks the marker segments up to the first SOS. Most UVC cameras leave the
+ * Huffman tables out of their MJPEG frames, like AVI1 Motion-JPEG does, and
+ * rely on the decoder knowing the standard ones.
+ *
+ * @return Offset of the SOS marker if the frame has no DHT segment before
+ * it, 0 if it has one or can't be parsed
+ */
+static size_t _uvc_mjpeg_dht_offset(const uint8_t *data, size_t bytes) {
+  size_t pos = 2;
+
+  if (bytes < 4 || data[0] != 0xff || data[1] != 0xd8)
+    return 0;
+
+  while (pos + 4 <= bytes) {
+    if (data[pos] != 0xff)
+      return 0;
+
+    switch (data[pos + 1]) {
+    case 0xff:
+      /* fill byte before a marker */
+      pos++;
+      break;
+    case 0xc4:
+      return 0;
+    case 0xda:
+      return pos;
+    case 0x01:
+    case 0xd0: case 0xd1: case 0xd2: case 0xd3:
+    case 0xd4: case 0xd5: case 0xd6: case 0xd7:
+      /* markers without a segment */
+      pos += 2;
+      break;
+    default:
+      /* segment lengths are big-endian */
+      pos += 2 + ((data[pos + 2] << 8) | data[pos + 3]);
+      break;
     }
+  }
 
-/** @brief Convert a frame from YUYV to UV (GRAY8)
+  return 0;
+}
+
+/** @brief Copy an MJPEG frame, adding the standard Huffman tables if it has none
  * @ingroup frame
  *
- * @param in YUYV frame
- * @param out GRAY8 frame
+ * Frames without a DHT segment can't be read by most JPEG decoders. The
+ * tables of ITU-T T.81 Annex K.3 are spliced in front of the SOS marker in
+ * the same pass that copies the frame. Frames that already have tables, or
+ * aren't recognised as JPEG, are copied as they are.
+ *
+ * @param dst Destination, at least bytes + UVC_MJPEG_DHT_BYTES long
+ * @param src MJPEG frame
+ * @param bytes Size of the MJPEG frame
+ * @return Number of bytes written to dst
  */
-uvc_error_t uvc_yuyv2uv(uvc_frame_t *in, uvc_frame_t *out) {
-  if (in->frame_format != UVC_FRAME_FORMAT_YUYV)
+size_t uvc_mjpeg_copy_dht(void *dst, const void *src, size_t bytes) {
+  uint8_t *out = dst;
+  const uint8_t *in = src;
+  size_t sos = _uvc_mjpeg_dht_offset(in, bytes);
+
+  if (!sos) {
+    memcpy(out, in, bytes);
+    return bytes;
+  }
+
+  memcpy(out, in, sos);
+  memcpy(out + sos, _uvc_mjpeg_dht, UVC_MJPEG_DHT_BYTES);
+  memcpy(out + sos + UVC_MJPEG_DHT_BYTES, in + sos, bytes - sos);
+  return bytes + UVC_MJPEG_DHT_BYTES;
+}
+
+/** @brief Copy an MJPEG frame into a standalone JPEG image
+ * @ingroup frame
+ *
+ * @see uvc_mjpeg_copy_dht
+ * @param in MJPEG frame
+ * @param out MJPEG frame with Huffman tables
+ */
+uvc_error_t uvc_mjpeg_insert_dht(uvc_frame_t *in, uvc_frame_t *out) {
+  if (in->frame_format != UVC_FRAME_FORMAT_MJPEG)
     return UVC_ERROR_INVALID_PARAM;
 
-  if (uvc_ensure_frame_size(out, in->width * in->height) < 0)
+  if (uvc_ensure_frame_size(out, in->data_bytes + UVC_MJPEG_DHT_BYTES) < 0)
     return UVC_ERROR_NO_MEM;
 
   out->width = in->width;
   out->height = in->height;
-  out->frame_format = UVC_FRAME_FORMAT_GRAY8;
-  out->step = in->width;
+  out->frame_format = UVC_FRAME_FORMAT_MJPEG;
+  out->step = 0;
   out->sequence = in->sequence;
   out->capture_time = in->capture_time;
+  out->arrival_time = in->arrival_time;
+  out->arrival_ns = in->arrival_ns;
+  out->errors = in->errors;
+  out->pts = in->pts;
+  out->scr = in->scr;
+  out->sof = in->sof;
+  out->has_pts = in->has_pts;
+  out->has_scr = in->has_scr;
   out->source = in->source;
 
-  uint8_t *pyuv = in->data;
-  uint8_t *puv = out->data;
-  uint8_t *puv_end = puv + out->data_bytes;
+  out->data_bytes = uvc_mjpeg_copy_dht(out->data, in->data, in->data_bytes);
 
-  while (puv < puv_end) {
-    IYUYV2UV(pyuv, puv);
+  return UVC_SUCCESS;
+}
 
-    puv += 1;
-    pyuv += 2;
+#ifdef LIBUVC_HAS_JPEG
+#include <setjmp.h>
+#include <jpeglib.h>
+
+/* MJPEG decoding through libjpeg(-turbo).
+ *
+ * A decoder keeps one decompressor and its scratch rows across frames, so
+ * only the first frame pays for setting them up. It must not be used by
+ * two threads at once.
+ */
+struct _uvc_jpeg_error_mgr {
+  struct jpeg_error_mgr super;
+  jmp_buf jmp;
+};
+
+struct uvc_mjpeg_decoder {
+  struct jpeg_decompress_struct dinfo;
+  struct _uvc_jpeg_error_mgr jerr;
+  /** iMCU row of raw Y, Cb, Cr samples for planar output */
+  uint8_t *raw;
+  size_t raw_bytes;
+};
+
+static void _uvc_jpeg_error_exit(j_common_ptr dinfo) {
+  struct _uvc_jpeg_error_mgr *jerr = (struct _uvc_jpeg_error_mgr *) dinfo->err;
+
+  longjmp(jerr->jmp, 1);
+}
+
+/* corrupt-data warnings are common with MJPEG, don't print them */
+static void _uvc_jpeg_output_message(j_common_ptr dinfo) {
+}
+
+/** @brief Create an MJPEG decoder
+ * @ingroup frame
+ *
+ * @return New decoder, or NULL on error
+ */
+uvc_mjpeg_decoder_t *uvc_mjpeg_decoder_create(void) {
+  uvc_mjpeg_decoder_t *dec = calloc(1, sizeof(*dec));
+
+  if (!dec)
+    return NULL;
+
+  dec->dinfo.err = jpeg_std_error(&dec->jerr.super);
+  dec->jerr.super.error_exit = _uvc_jpeg_error_exit;
+  dec->jerr.super.output_message = _uvc_jpeg_output_message;
+
+  if (setjmp(dec->jerr.jmp)) {
+    free(dec);
+    return NULL;
   }
+  jpeg_create_decompress(&dec->dinfo);
 
-  return UVC_SUCCESS;
+  return dec;
 }
 
-#define IUYVY2RGB_2(pyuv, prgb) { \
-    int r = (22987 * ((pyuv)[2] - 128)) >> 14; \
-    int g = (-5636 * ((pyuv)[0] - 128) - 11698 * ((pyuv)[2] - 128)) >> 14; \
-    int b = (29049 * ((pyuv)[0] - 128)) >> 14; \
-    (prgb)[0] = sat((pyuv)[1] + r); \
-    (prgb)[1] = sat((pyuv)[1] + g); \
-    (prgb)[2] = sat((pyuv)[1] + b); \
-    (prgb)[3] = sat((pyuv)[3] + r); \
-    (prgb)[4] = sat((pyuv)[3] + g); \
-    (prgb)[5] = sat((pyuv)[3] + b); \
-    }
-#define IUYVY2RGB_16(pyuv, prgb) IUYVY2RGB_8(pyuv, prgb); IUYVY2RGB_8(pyuv + 16, prgb + 24);
-#define IUYVY2RGB_8(pyuv, prgb) IUYVY2RGB_4(pyuv, prgb); IUYVY2RGB_4(pyuv + 8, prgb + 12);
-#define IUYVY2RGB_4(pyuv, prgb) IUYVY2RGB_2(pyuv, prgb); IUYVY2RGB_2(pyuv + 4, prgb + 6);
+/** @brief Free an MJPEG decoder
+ * @ingroup frame
+ */
+void uvc_mjpeg_decoder_destroy(uvc_mjpeg_decoder_t *dec) {
+  if (!dec)
+    return;
 
-/** @brief Convert a frame from UYVY to RGB
+  jpeg_destroy_decompress(&dec->dinfo);
+  free(dec->raw);
+  free(dec);
+}
+
+/** @internal
+ * @brief Point the decoder at a frame and read its header
+ */
+static uvc_error_t _uvc_mjpeg_start(uvc_mjpeg_decoder_t *dec, uvc_frame_t *in) {
+  if (in->frame_format != UVC_FRAME_FORMAT_MJPEG || !in->data || in->data_bytes == 0)
+    return UVC_ERROR_INVALID_PARAM;
+
+  jpeg_mem_src(&dec->dinfo, in->data, in->data_bytes);
+  jpeg_read_header(&dec->dinfo, TRUE);
+  dec->dinfo.dct_method = JDCT_IFAST;
+
+  return UVC_SUCCESS;
+}
+
+/** @brief Decode an MJPEG frame to RGB, BGR or GRAY8
  * @ingroup frame
- * @param ini UYVY frame
- * @param out RGB frame
+ *
+ * The output takes the size stored in the JPEG stream.
+ *
+ * @param dec Decoder, not in use by another thread
+ * @param in MJPEG frame
+ * @param out Output frame
+ * @param format UVC_FRAME_FORMAT_RGB, UVC_FRAME_FORMAT_BGR or UVC_FRAME_FORMAT_GRAY8
  */
-uvc_error_t uvc_uyvy2rgb(uvc_frame_t *in, uvc_frame_t *out) {
-  if (in->frame_format != UVC_FRAME_FORMAT_UYVY)
+uvc_error_t uvc_mjpeg_decode(uvc_mjpeg_decoder_t *dec, uvc_frame_t *in, uvc_frame_t *out,
+                             enum uvc_frame_format format) {
+  return uvc_mjpeg_decode_scaled(dec, in, out, format, 1);
+}
+
+/** @brief Decode an MJPEG frame to RGB, BGR or GRAY8 at reduced size
+ * @ingroup frame
+ *
+ * Scaling happens in the inverse DCT, which then works on fewer
+ * coefficients: at 1/8 each 8x8 block becomes a single pixel. That is much
+ * cheaper than a full decode followed by downscaling. The output is the
+ * JPEG size divided by @p scale_denom, rounded up.
+ *
+ * @param dec Decoder, not in use by another thread
+ * @param in MJPEG frame
+ * @param out Output frame
+ * @param format UVC_FRAME_FORMAT_RGB, UVC_FRAME_FORMAT_BGR or UVC_FRAME_FORMAT_GRAY8
+ * @param scale_denom 1, 2, 4 or 8
+ */
+uvc_error_t uvc_mjpeg_decode_scaled(uvc_mjpeg_decoder_t *dec, uvc_frame_t *in, uvc_frame_t *out,
+                                    enum uvc_frame_format format, int scale_denom) {
+  struct jpeg_decompress_struct *dinfo = &dec->dinfo;
+  JSAMPROW rows[16];
+  uvc_error_t ret;
+  size_t step;
+  int i, pixel_bytes;
+
+  switch (format) {
+    case UVC_FRAME_FORMAT_RGB:
+    case UVC_FRAME_FORMAT_BGR:
+      pixel_bytes = 3;
+      break;
+    case UVC_FRAME_FORMAT_GRAY8:
+      pixel_bytes = 1;
+      break;
+    default:
+      return UVC_ERROR_NOT_SUPPORTED;
+  }
+
+  if (scale_denom != 1 && scale_denom != 2 && scale_denom != 4 && scale_denom != 8)
     return UVC_ERROR_INVALID_PARAM;
 
-  if (uvc_ensure_frame_size(out, in->width * in->height * 3) < 0)
+  if (setjmp(dec->jerr.jmp)) {
+    jpeg_abort_decompress(dinfo);
+    return UVC_ERROR_OTHER;
+  }
+
+  ret = _uvc_mjpeg_start(dec, in);
+  if (ret != UVC_SUCCESS)
+    return ret;
+
+  dinfo->out_color_space = format == UVC_FRAME_FORMAT_RGB ? JCS_RGB :
+                           format == UVC_FRAME_FORMAT_BGR ? JCS_EXT_BGR : JCS_GRAYSCALE;
+  dinfo->scale_num = 1;
+  dinfo->scale_denom = scale_denom;
+  jpeg_calc_output_dimensions(dinfo);
+
+  step = (size_t) dinfo->output_width * pixel_bytes;
+  if (uvc_ensure_frame_size(out, step * dinfo->output_height) < 0) {
+    jpeg_abort_decompress(dinfo);
     return UVC_ERROR_NO_MEM;
+  }
 
-  out->width = in->width;
-  out->height = in->height;
-  out->frame_format = UVC_FRAME_FORMAT_RGB;
-  out->step = in->width *3;
+  out->width = dinfo->output_width;
+  out->height = dinfo->output_height;
+  out->frame_format = format;
+  out->step = step;
   out->sequence = in->sequence;
   out->capture_time = in->capture_time;
+  out->arrival_time = in->arrival_time;
+  out->arrival_ns = in->arrival_ns;
+  out->errors = in->errors;
+  out->pts = in->pts;
+  out->scr = in->scr;
+  out->sof = in->sof;
+  out->has_pts = in->has_pts;
+  out->has_scr = in->has_scr;
   out->source = in->source;
 
-  uint8_t *pyuv = in->data;
-  uint8_t *prgb = out->data;
-  uint8_t *prgb_end = prgb + out->data_bytes;
+  jpeg_start_decompress(dinfo);
 
-  while (prgb < prgb_end) {
-    IUYVY2RGB_8(pyuv, prgb);
+  while (dinfo->output_scanline < dinfo->output_height) {
+    int n = dinfo->output_height - dinfo->output_scanline;
 
-    prgb += 3 * 8;
-    pyuv += 2 * 8;
+    if (n > 16)
+      n = 16;
+    for (i = 0; i < n; i++)
+      rows[i] = (uint8_t *) out->data + (dinfo->output_scanline + i) * step;
+    jpeg_read_scanlines(dinfo, rows, n);
   }
 
+  jpeg_finish_decompress(dinfo);
+
   return UVC_SUCCESS;
 }
 
-#define IUYVY2BGR_2(pyuv, pbgr) { \
-    int r = (22987 * ((pyuv)[2] - 128)) >> 14; \
-    int g = (-5636 * ((pyuv)[0] - 128) - 11698 * ((pyuv)[2] - 128)) >> 14; \
-    int b = (29049 * ((pyuv)[0] - 128)) >> 14; \
-    (pbgr)[0] = sat((pyuv)[1] + b); \
-    (pbgr)[1] = sat((pyuv)[1] + g); \
-    (pbgr)[2] = sat((pyuv)[1] + r); \
-    (pbgr)[3] = sat((pyuv)[3] + b); \
-    (pbgr)[4] = sat((pyuv)[3] + g); \
-    (pbgr)[5] = sat((pyuv)[3] + r); \
-    }
-#define IUYVY2BGR_16(pyuv, pbgr) IUYVY2BGR_8(pyuv, pbgr); IUYVY2BGR_8(pyuv + 16, pbgr + 24);
-#define IUYVY2BGR_8(pyuv, pbgr) IUYVY2BGR_4(pyuv, pbgr); IUYVY2BGR_4(pyuv + 8, pbgr + 12);
-#define IUYVY2BGR_4(pyuv, pbgr) IUYVY2BGR_2(pyuv, pbgr); IUYVY2BGR_2(pyuv + 4, pbgr + 6);
-
-/** @brief Convert a frame from UYVY to BGR
+/** @brief Decode an MJPEG frame to I420
  * @ingroup frame
- * @param ini UYVY frame
- * @param out BGR frame
- */
-uvc_error_t uvc_uyvy2bgr(uvc_frame_t *in, uvc_frame_t *out) {
-  if (in->frame_format != UVC_FRAME_FORMAT_UYVY)
+ *
+ * Reads the Y, Cb and Cr samples straight out of the JPEG stream, skipping
+ * colour conversion and upsampling. Streams must be 4:2:0 or 4:2:2, the
+ * usual MJPEG layouts; 4:2:2 chroma of each two rows is averaged. The
+ * planes are as for uvc_yuyv2i420, sized by the JPEG stream.
+ *
+ * @param dec Decoder, not in use by another thread
+ * @param in MJPEG frame
+ */
+uvc_error_t uvc_mjpeg_decode_i420(uvc_mjpeg_decoder_t *dec, uvc_frame_t *in,
+                                  uint8_t *y, size_t y_stride,
+                                  uint8_t *u, size_t u_stride, uint8_t *v, size_t v_stride) {
+  struct jpeg_decompress_struct *dinfo = &dec->dinfo;
+  jpeg_component_info *comp;
+  JSAMPROW rows[3][16];
+  JSAMPARRAY planes[3] = { rows[0], rows[1], rows[2] };
+  size_t y_width, c_width, width, c_rows, need;
+  uint32_t height, row;
+  int v_samp, i;
+  uvc_error_t ret;
+
+  if (!y || !u || !v)
     return UVC_ERROR_INVALID_PARAM;
 
-  if (uvc_ensure_frame_size(out, in->width * in->height * 3) < 0)
-    return UVC_ERROR_NO_MEM;
+  if (setjmp(dec->jerr.jmp)) {
+    jpeg_abort_decompress(dinfo);
+    return UVC_ERROR_OTHER;
+  }
 
-  out->width = in->width;
-  out->height = in->height;
-  out->frame_format = UVC_FRAME_FORMAT_BGR;
-  out->step = in->width *3;
-  out->sequence = in->sequence;
-  out->capture_time = in->capture_time;
-  out->source = in->source;
+  ret = _uvc_mjpeg_start(dec, in);
+  if (ret != UVC_SUCCESS)
+    return ret;
 
-  uint8_t *pyuv = in->data;
-  uint8_t *pbgr = out->data;
-  uint8_t *pbgr_end = pbgr + out->data_bytes;
+  comp = dinfo->comp_info;
+  v_samp = comp[0].v_samp_factor;
+  if (dinfo->num_components != 3 || comp[0].h_samp_factor != 2 || (v_samp != 1 && v_samp != 2) ||
+      comp[1].h_samp_factor != 1 || comp[1].v_samp_factor != 1 ||
+      comp[2].h_samp_factor != 1 || comp[2].v_samp_factor != 1) {
+    jpeg_abort_decompress(dinfo);
+    return UVC_ERROR_NOT_SUPPORTED;
+  }
+
+  width = dinfo->image_width;
+  height = dinfo->image_height;
+  if (y_stride < width || u_stride < (width + 1) / 2 || v_stride < (width + 1) / 2) {
+    jpeg_abort_decompress(dinfo);
+    return UVC_ERROR_INVALID_PARAM;
+  }
+
+  /* raw rows are padded to whole blocks */
+  y_width = comp[0].width_in_blocks * DCTSIZE;
+  c_width = comp[1].width_in_blocks * DCTSIZE;
+  need = y_width * v_samp * DCTSIZE + 2 * c_width * DCTSIZE;
+  if (dec->raw_bytes < need) {
+    uint8_t *raw = realloc(dec->raw, need);
+    if (!raw) {
+      jpeg_abort_decompress(dinfo);
+      return UVC_ERROR_NO_MEM;
+    }
+    dec->raw = raw;
+    dec->raw_bytes = need;
+  }
+
+  for (i = 0; i < v_samp * DCTSIZE; i++)
+    rows[0][i] = dec->raw + i * y_width;
+  for (i = 0; i < DCTSIZE; i++) {
+    rows[1][i] = dec->raw + y_width * v_samp * DCTSIZE + i * c_width;
+    rows[2][i] = rows[1][i] + c_width * DCTSIZE;
+  }
+
+  dinfo->raw_data_out = TRUE;
+  jpeg_start_decompress(dinfo);
+
+  /* each iMCU row gives v_samp * 8 luma rows and 8 chroma rows */
+  for (row = 0; row < height; row += v_samp * DCTSIZE) {
+    size_t c_row = row / 2;
+
+    jpeg_read_raw_data(dinfo, planes, v_samp * DCTSIZE);
 
-  while (pbgr < pbgr_end) {
-    IUYVY2BGR_8(pyuv, pbgr);
+    for (i = 0; i < v_samp * DCTSIZE && row + i < height; i++)
+      memcpy(y + (row + i) * y_stride, rows[0][i], width);
 
-    pbgr += 3 * 8;
-    pyuv += 2 * 8;
+    c_rows = ((size_t) (row + v_samp * DCTSIZE < height ? row + v_samp * DCTSIZE : height) + 1) / 2 - c_row;
+    for (i = 0; i < (int) c_rows; i++) {
+      if (v_samp == 2) {
+        memcpy(u + (c_row + i) * u_stride, rows[1][i], (width + 1) / 2);
+        memcpy(v + (c_row + i) * v_stride, rows[2][i], (width + 1) / 2);
+      } else {
+        /* 4:2:2, an odd last row pairs up with itself */
+        int i1 = row + 2 * i + 1 < height ? 2 * i + 1 : 2 * i;
+        size_t x;
+
+        for (x = 0; x < (width + 1) / 2; x++) {
+          u[(c_row + i) * u_stride + x] = (rows[1][2 * i][x] + rows[1][i1][x] + 1) >> 1;
+          v[(c_row + i) * v_stride + x] = (rows[2][2 * i][x] + rows[2][i1][x] + 1) >> 1;
+        }
+      }
+    }
   }
 
+  jpeg_finish_decompress(dinfo);
+
   return UVC_SUCCESS;
 }
 
-/** @brief Convert a frame to RGB
+/** @internal
+ * @brief Decode with a decoder made for this one frame
+ */
+static uvc_error_t _uvc_mjpeg_decode_once(uvc_frame_t *in, uvc_frame_t *out, enum uvc_frame_format format) {
+  uvc_mjpeg_decoder_t *dec = uvc_mjpeg_decoder_create();
+  uvc_error_t ret;
+
+  if (!dec)
+    return UVC_ERROR_NO_MEM;
+
+  ret = uvc_mjpeg_decode(dec, in, out, format);
+  uvc_mjpeg_decoder_destroy(dec);
+
+  return ret;
+}
+
+/** @brief Convert an MJPEG frame to RGB
  * @ingroup frame
  *
- * @param in non-RGB frame
+ * Sets up a decoder for each call; keep one with uvc_mjpeg_decoder_create
+ * and uvc_mjpeg_decode when converting a stream.
+ *
+ * @param in MJPEG frame
  * @param out RGB frame
  */
-uvc_error_t uvc_any2rgb(uvc_frame_t *in, uvc_frame_t *out) {
-  switch (in->frame_format) {
-    case UVC_FRAME_FORMAT_YUYV:
-      return uvc_yuyv2rgb(in, out);
-    case UVC_FRAME_FORMAT_UYVY:
-      return uvc_uyvy2rgb(in, out);
-    case UVC_FRAME_FORMAT_RGB:
-      return uvc_duplicate_frame(in, out);
-    default:
-      return UVC_ERROR_NOT_SUPPORTED;
-  }
+uvc_error_t uvc_mjpeg2rgb(uvc_frame_t *in, uvc_frame_t *out) {
+  return _uvc_mjpeg_decode_once(in, out, UVC_FRAME_FORMAT_RGB);
 }
 
-/** @brief Convert a frame to BGR
+/** @brief Convert an MJPEG frame to BGR
  * @ingroup frame
  *
- * @param in non-BGR frame
+ * @see uvc_mjpeg2rgb
+ * @param in MJPEG frame
  * @param out BGR frame
  */
-uvc_error_t uvc_any2bgr(uvc_frame_t *in, uvc_frame_t *out) {
-  switch (in->frame_format) {
-    case UVC_FRAME_FORMAT_YUYV:
-      return uvc_yuyv2bgr(in, out);
-    case UVC_FRAME_FORMAT_UYVY:
-      return uvc_uyvy2bgr(in, out);
-    case UVC_FRAME_FORMAT_BGR:
-      return uvc_duplicate_frame(in, out);
-    default:
-      return UVC_ERROR_NOT_SUPPORTED;
-  }
+uvc_error_t uvc_mjpeg2bgr(uvc_frame_t *in, uvc_frame_t *out) {
+  return _uvc_mjpeg_decode_once(in, out, UVC_FRAME_FORMAT_BGR);
+}
+
+/** @brief Convert an MJPEG frame to GRAY8
+ * @ingroup frame
+ *
+ * @see uvc_mjpeg2rgb
+ * @param in MJPEG frame
+ * @param out GRAY8 frame
+ */
+uvc_error_t uvc_mjpeg2gray(uvc_frame_t *in, uvc_frame_t *out) {
+  return _uvc_mjpeg_decode_once(in, out, UVC_FRAME_FORMAT_GRAY8);
 }
+#endif /* LIBUVC_HAS_JPEG */
@@ -113,6 +113,18 @@ enum uvc_frame_format {
   UVC_FRAME_FORMAT_COUNT,
 };
 
+/** Demosaic algorithms for raw Bayer frames
+ * @see uvc_bayer2rgb
+ */
+enum uvc_demosaic_method {
+  /** Average of the nearest samples of each colour, cheap enough for preview */
+  UVC_DEMOSAIC_BILINEAR = 0,
+  /** Green interpolated along edges, red and blue as differences to green */
+  UVC_DEMOSAIC_EDGE_AWARE,
+  /** One pixel per 2x2 cell: half the width and height, no interpolation */
+  UVC_DEMOSAIC_SUPERPIXEL,
+};
+
 /* UVC_COLOR_FORMAT_* have been replaced with UVC_FRAME_FORMAT_*. Please use
  * UVC_FRAME_FORMAT_* instead of using these. */
 #define UVC_COLOR_FORMAT_UNKNOWN UVC_FRAME_FORMAT_UNKNOWN
@@ -467,6 +479,31 @@ typedef struct uvc_frame {
   uint32_t sequence;
   /** Estimate of system time when the device started capturing the image */
   struct timeval capture_time;
+  /** Presentation time stamp from the payload headers: device clock
+   * (dwClockFrequency) at the start of capture. Valid if has_pts is set. */
+  uint32_t pts;
+  /** Source clock reference of the frame's last payload that carried one:
+   * device clock (scr) and 11 bit USB SOF counter (sof) it was sampled in.
+   * Valid if has_scr is set. */
+  uint32_t scr;
+  uint16_t sof;
+  uint8_t has_pts;
+  uint8_t has_scr;
+  /** System time the last payload of the frame arrived */
+  struct timeval arrival_time;
+  /** The same instant on the host monotonic clock, in ns, for measuring
+   * latency against uvc_monotonic_ns() */
+  int64_t arrival_ns;
+  /** Integrity problems found by UVC_STREAM_FLAG_VALIDATE (enum
+   * uvc_frame_error), 0 if none were found or the stream doesn't check */
+  uint8_t errors;
+  /** Payload header bytes past the standard fields, where devices put
+   * per-frame metadata such as exposure, gain or sensor timestamps (UVC 1.5
+   * / Microsoft metadata). One entry per payload whose extension differs
+   * from the previous one: a length byte followed by that many bytes. Owned
+   * by the stream, valid as long as the frame data. */
+  void *metadata;
+  size_t metadata_bytes;
   /** Handle on the device that produced the image.
    * @warning You must not call any uvc_* functions during a callback. */
   uvc_device_handle_t *source;
@@ -484,6 +521,96 @@ typedef struct uvc_frame {
  */
 typedef void(uvc_frame_callback_t)(struct uvc_frame *frame, void *user_ptr);
 
+/** Stream setup flags, passed to uvc_stream_start()
+ * @ingroup streaming
+ */
+enum uvc_stream_flags {
+  /** Lend the assembled frame buffer to the consumer instead of copying it
+   * into the frame. The frame data stays valid until it is handed back with
+   * uvc_stream_release_buffer(). */
+  UVC_STREAM_FLAG_ZERO_COPY = (1 << 1),
+  /** Bulk streams only: receive each transfer straight into the frame
+   * buffer at the current write offset, so only the payload header is
+   * stripped and the image data is never copied. This keeps a single
+   * transfer in flight, since the offset of the next one is only known once
+   * the current one completes; use it with a large dwMaxPayloadTransferSize. */
+  UVC_STREAM_FLAG_DIRECT_BULK = (1 << 2),
+  /** Check each completed frame before it is published: the payload error
+   * bit for every format, and the SOI/EOI markers and a plausible size for
+   * MJPEG. Corrupt frames are dropped and counted in uvc_stream_stats_t. */
+  UVC_STREAM_FLAG_VALIDATE = (1 << 3),
+  /** With UVC_STREAM_FLAG_VALIDATE, deliver corrupt frames with
+   * uvc_frame_t.errors set instead of dropping them */
+  UVC_STREAM_FLAG_KEEP_CORRUPT = (1 << 4),
+  /** MJPEG streams: add the standard Huffman tables to frames that come
+   * without them while the frame is copied out of its slot, see
+   * uvc_mjpeg_copy_dht(). Lent frames (UVC_STREAM_FLAG_ZERO_COPY) are
+   * delivered as the device sent them. */
+  UVC_STREAM_FLAG_MJPEG_DHT = (1 << 5)
+};
+
+/** Integrity problems of a frame, see UVC_STREAM_FLAG_VALIDATE
+ * @ingroup streaming
+ */
+enum uvc_frame_error {
+  /** The device set the error bit in a payload header of the frame; the
+   * data of that payload is missing */
+  UVC_FRAME_ERROR_PAYLOAD = (1 << 0),
+  /** MJPEG frame doesn't start with an SOI marker */
+  UVC_FRAME_ERROR_NO_SOI = (1 << 1),
+  /** MJPEG frame doesn't end with an EOI marker, usually truncated */
+  UVC_FRAME_ERROR_NO_EOI = (1 << 2),
+  /** MJPEG frame too small to hold an image of the stream's size */
+  UVC_FRAME_ERROR_SIZE = (1 << 3)
+};
+
+/** Number of buckets of a uvc_histogram_t */
+#define UVC_HIST_BUCKETS 168
+
+/** Fixed-bucket histogram of durations in microseconds
+ * @ingroup streaming
+ *
+ * Buckets 0 to 7 hold 0 to 7 us. Above that, every power of two is split in
+ * eight, so no bucket is wider than 12.5% of its lower bound: a duration of
+ * us microseconds with e = floor(log2(us)) falls into bucket
+ * (e - 2) * 8 + ((us >> (e - 3)) & 7). The last bucket also takes
+ * everything longer, from about 8 s.
+ */
+typedef struct uvc_histogram {
+  uint32_t buckets[UVC_HIST_BUCKETS];
+  uint32_t count;
+  uint64_t sum_us;
+  uint32_t min_us;
+  uint32_t max_us;
+} uvc_histogram_t;
+
+/** Stream counters, see uvc_stream_get_stats()
+ * @ingroup streaming
+ */
+typedef struct uvc_stream_stats {
+  /** Frames completed by the device */
+  uint32_t frames;
+  /** Completed frames discarded because every frame slot was in use */
+  uint32_t dropped_frames;
+  /** Times a frame slot was enlarged because the device sent more than
+   * dwMaxVideoFrameSize */
+  uint32_t grown_slots;
+  /** Frames discarded because they exceeded LIBUVC_MAX_FRAME_SIZE */
+  uint32_t overflowed_frames;
+  /** Frames found corrupt by UVC_STREAM_FLAG_VALIDATE, by problem; a
+   * frame may count towards several */
+  uint32_t payload_errors;
+  uint32_t missing_soi;
+  uint32_t missing_eoi;
+  uint32_t bad_size;
+  /** Corrupt frames discarded, unless UVC_STREAM_FLAG_KEEP_CORRUPT is set */
+  uint32_t corrupt_frames;
+  /** Time between the ends of consecutive frames completed by the device */
+  uvc_histogram_t frame_intervals;
+  /** Frames that ended more than 1.5 dwFrameInterval after the previous one */
+  uint32_t late_frames;
+} uvc_stream_stats_t;
+
 /** Streaming mode, includes all information needed to select stream
  * @ingroup streaming
  */
@@ -590,6 +717,8 @@ uvc_error_t uvc_start_iso_streaming(
 void uvc_stop_streaming(uvc_device_handle_t *devh);
 
 uvc_error_t uvc_stream_open_ctrl(uvc_device_handle_t *devh, uvc_stream_handle_t **strmh, uvc_stream_ctrl_t *ctrl);
+uvc_error_t uvc_stream_open_ctrl_slots(uvc_device_handle_t *devh, uvc_stream_handle_t **strmh, uvc_stream_ctrl_t *ctrl,
+    int num_slots);
 uvc_error_t uvc_stream_ctrl(uvc_stream_handle_t *strmh, uvc_stream_ctrl_t *ctrl);
 uvc_error_t uvc_stream_start(uvc_stream_handle_t *strmh,
     uvc_frame_callback_t *cb,
@@ -603,6 +732,13 @@ uvc_error_t uvc_stream_get_frame(
     uvc_frame_t **frame,
     int32_t timeout_us
 );
+uvc_error_t uvc_stream_set_transfers(uvc_stream_handle_t *strmh, int num_transfers, int packets_per_transfer);
+void uvc_stream_get_transfers(uvc_stream_handle_t *strmh, int *num_transfers, int *packets_per_transfer,
+    size_t *transfer_size, int *dev_mem_transfers);
+void uvc_stream_release_buffer(uvc_stream_handle_t *strmh, void *data, uint32_t sequence);
+int uvc_stream_lent_buffers(uvc_stream_handle_t *strmh);
+void uvc_stream_get_stats(uvc_stream_handle_t *strmh, uvc_stream_stats_t *stats);
+int64_t uvc_monotonic_ns(void);
 uvc_error_t uvc_stream_stop(uvc_stream_handle_t *strmh);
 void uvc_stream_close(uvc_stream_handle_t *strmh);
 
@@ -745,6 +881,10 @@ void uvc_free_frame(uvc_frame_t *frame);
 
 uvc_error_t uvc_duplicate_frame(uvc_frame_t *in, uvc_frame_t *out);
 
+uvc_error_t uvc_set_conversion_threads(int num_threads);
+int uvc_get_conversion_threads(void);
+void uvc_set_simd(int enable);
+
 uvc_error_t uvc_yuyv2rgb(uvc_frame_t *in, uvc_frame_t *out);
 uvc_error_t uvc_uyvy2rgb(uvc_frame_t *in, uvc_frame_t *out);
 uvc_error_t uvc_any2rgb(uvc_frame_t *in, uvc_frame_t *out);
@@ -753,11 +893,50 @@ uvc_error_t uvc_yuyv2bgr(uvc_frame_t *in, uvc_frame_t *out);
 uvc_error_t uvc_uyvy2bgr(uvc_frame_t *in, uvc_frame_t *out);
 uvc_error_t uvc_any2bgr(uvc_frame_t *in, uvc_frame_t *out);
 
+uvc_error_t uvc_bayer2rgb(uvc_frame_t *in, uvc_frame_t *out, enum uvc_demosaic_method method);
+uvc_error_t uvc_bayer2bgr(uvc_frame_t *in, uvc_frame_t *out, enum uvc_demosaic_method method);
+
+uvc_error_t uvc_yuyv2nv12(uvc_frame_t *in, uint8_t *y, size_t y_stride, uint8_t *uv, size_t uv_stride);
+uvc_error_t uvc_uyvy2nv12(uvc_frame_t *in, uint8_t *y, size_t y_stride, uint8_t *uv, size_t uv_stride);
+uvc_error_t uvc_any2nv12(uvc_frame_t *in, uint8_t *y, size_t y_stride, uint8_t *uv, size_t uv_stride);
+
+uvc_error_t uvc_yuyv2i420(uvc_frame_t *in, uint8_t *y, size_t y_stride,
+                          uint8_t *u, size_t u_stride, uint8_t *v, size_t v_stride);
+uvc_error_t uvc_uyvy2i420(uvc_frame_t *in, uint8_t *y, size_t y_stride,
+                          uint8_t *u, size_t u_stride, uint8_t *v, size_t v_stride);
+uvc_error_t uvc_any2i420(uvc_frame_t *in, uint8_t *y, size_t y_stride,
+                         uint8_t *u, size_t u_stride, uint8_t *v, size_t v_stride);
+
 uvc_error_t uvc_yuyv2y(uvc_frame_t *in, uvc_frame_t *out);
+uvc_error_t uvc_uyvy2y(uvc_frame_t *in, uvc_frame_t *out);
+uvc_error_t uvc_any2y(uvc_frame_t *in, uvc_frame_t *out);
 uvc_error_t uvc_yuyv2uv(uvc_frame_t *in, uvc_frame_t *out);
 
+/** Size of the DHT segment uvc_mjpeg_copy_dht() may add to a frame */
+#define UVC_MJPEG_DHT_BYTES 420
+
+size_t uvc_mjpeg_copy_dht(void *dst, const void *src, size_t bytes);
+uvc_error_t uvc_mjpeg_insert_dht(uvc_frame_t *in, uvc_frame_t *out);
+
 #ifdef LIBUVC_HAS_JPEG
+/** Reusable MJPEG decoder
+ * @see uvc_mjpeg_decoder_create
+ */
+typedef struct uvc_mjpeg_decoder uvc_mjpeg_decoder_t;
+
+uvc_mjpeg_decoder_t *uvc_mjpeg_decoder_create(void);
+void uvc_mjpeg_decoder_destroy(uvc_mjpeg_decoder_t *dec);
+uvc_error_t uvc_mjpeg_decode(uvc_mjpeg_decoder_t *dec, uvc_frame_t *in, uvc_frame_t *out,
+                             enum uvc_frame_format format);
+uvc_error_t uvc_mjpeg_decode_scaled(uvc_mjpeg_decoder_t *dec, uvc_frame_t *in, uvc_frame_t *out,
+                                    enum uvc_frame_format format, int scale_denom);
+uvc_error_t uvc_mjpeg_decode_i420(uvc_mjpeg_decoder_t *dec, uvc_frame_t *in,
+                                  uint8_t *y, size_t y_stride,
+                                  uint8_t *u, size_t u_stride, uint8_t *v, size_t v_stride);
+
 uvc_error_t uvc_mjpeg2rgb(uvc_frame_t *in, uvc_frame_t *out);
+uvc_error_t uvc_mjpeg2bgr(uvc_frame_t *in, uvc_frame_t *out);
+uvc_error_t uvc_mjpeg2gray(uvc_frame_t *in, uvc_frame_t *out);
 #endif
 
 #ifdef __cplusplus
@@ -1469,17 +1648,122 @@ typedef struct uvc_device_info {
 } uvc_device_info_t;
 
 /*
-  set a high number of transfer buffers. This uses a lot of ram, but
-  avoids problems with scheduling delays on slow boards causing missed
-  transfers. A better approach may be to make the transfer thread FIFO
-  scheduled (if we have root).
-  We could/should change this to allow reduce it to, say, 5 by default
-  and then allow the user to change the number of buffers as required.
+  Upper bound on the transfers a stream keeps in flight. Unless set with
+  uvc_stream_set_transfers, enough transfers are queued to cover
+  LIBUVC_TRANSFER_QUEUE_US or two frame intervals, whichever is longer, of
+  the negotiated bandwidth. More transfers absorb scheduling delays on slow
+  boards at the cost of ram.
  */
 #define LIBUVC_NUM_TRANSFER_BUFS 100
+#define LIBUVC_MIN_TRANSFER_BUFS 2
+#define LIBUVC_TRANSFER_QUEUE_US 100000
+
+/* Default cap and upper bound on the packets per isochronous transfer */
+#define LIBUVC_ISO_PACKETS 32
+#define LIBUVC_MAX_ISO_PACKETS 1024
 
 #define LIBUVC_XFER_BUF_SIZE	( 16 * 1024 * 1024 )
 
+/* Frame slots are sized from the negotiated dwMaxVideoFrameSize (or
+ * LIBUVC_XFER_BUF_SIZE if the device reports none) and grown on demand for
+ * devices that overrun it, but never beyond this. */
+#define LIBUVC_MAX_FRAME_SIZE	( 64 * 1024 * 1024 )
+
+/* Upper bound for uvc_set_conversion_threads */
+#define LIBUVC_MAX_CONVERSION_THREADS 64
+/* Smallest band of pixels worth handing to a conversion worker */
+#define LIBUVC_CONVERSION_BAND_PIXELS 65536
+
+/* Bytes reserved in front of each frame slot, so that a direct bulk transfer
+ * can put the payload header (at most 255 bytes) before the image data */
+#define LIBUVC_SLOT_HEADROOM 256
+
+/* Default number of frame buffers per stream. One is always being filled by
+ * the transfer callbacks, the others hold completed frames until the consumer
+ * gets to them. */
+#define LIBUVC_NUM_FRAME_SLOTS 2
+#define LIBUVC_MAX_FRAME_SLOTS 64
+
+/* Payload header extension bytes kept per frame, see uvc_frame_t.metadata.
+ * Entries that don't fit anymore are dropped. */
+#define LIBUVC_METADATA_SIZE 2048
+
+/* Frames the fit between device clock and USB SOF counter spans */
+#define LIBUVC_CLOCK_SAMPLES 32
+
+/** Minimum of the values seen over the last one to two seconds */
+struct uvc_clock_min {
+  int64_t cur;
+  int64_t prev;
+  int64_t start_ns;
+};
+
+/** Device to host clock recovery of a stream
+ *
+ * The SCR of the payload headers pairs the device clock (STC, running at
+ * dwClockFrequency) with the USB SOF counter it was sampled in. The SOF
+ * counter is the host controller's millisecond clock, so the pairs fit a
+ * line that needs no host timestamps, and host time of an SOF is the least
+ * delayed arrival of a payload sent in it. A PTS is mapped along both.
+ * Devices with a bogus SOF counter fall back to pairing STC with arrival
+ * time directly. Owned by the transfer callbacks.
+ */
+struct uvc_clock {
+  /** device clock frequency in Hz, 0 if unknown */
+  uint32_t freq;
+  /** set once an SCR has been seen */
+  uint8_t valid;
+  /** latest SCR: raw and unwrapped STC and SOF, arrival (host monotonic) */
+  uint32_t stc_raw;
+  uint16_t sof_raw;
+  int64_t stc;
+  int64_t sof;
+  int64_t host_ns;
+  /** one (STC, SOF) pair per frame, ring of LIBUVC_CLOCK_SAMPLES */
+  int64_t sample_stc[LIBUVC_CLOCK_SAMPLES];
+  int64_t sample_sof[LIBUVC_CLOCK_SAMPLES];
+  int head;
+  int count;
+  /** host time minus SOF (ms) and minus STC, in ns */
+  struct uvc_clock_min sof_offset;
+  struct uvc_clock_min stc_offset;
+};
+
+enum uvc_frame_slot_state {
+  UVC_FRAME_SLOT_FREE = 0,
+  /** being assembled from payloads */
+  UVC_FRAME_SLOT_FILLING,
+  /** complete, waiting for the consumer */
+  UVC_FRAME_SLOT_READY,
+  /** lent to the consumer (UVC_STREAM_FLAG_ZERO_COPY) */
+  UVC_FRAME_SLOT_LENT
+};
+
+/** One frame buffer of a stream's ring */
+struct uvc_frame_slot {
+  /** allocation, buf starts LIBUVC_SLOT_HEADROOM bytes into it */
+  uint8_t *mem;
+  uint8_t *buf;
+  /** allocated size of buf */
+  size_t size;
+  size_t bytes;
+  uint32_t seq;
+  uint32_t pts;
+  uint32_t last_scr;
+  uint16_t last_sof;
+  struct timeval capture_time;
+  struct timeval arrival_time;
+  int64_t arrival_ns;
+  /** payload header bits seen in the frame, see uvc_stream_handle */
+  uint8_t info;
+  /** payload header extensions of the frame, see uvc_frame_t.metadata */
+  uint8_t meta[LIBUVC_METADATA_SIZE];
+  size_t meta_bytes;
+  /** enum uvc_frame_error bits found when the frame was completed */
+  uint8_t errors;
+  enum uvc_frame_slot_state state;
+};
+
 struct uvc_stream_handle {
   struct uvc_device_handle *devh;
   struct uvc_stream_handle *prev, *next;
@@ -1490,24 +1774,71 @@ struct uvc_stream_handle {
   /** Current control block */
   struct uvc_stream_ctrl cur_ctrl;
 
-  /* listeners may only access hold*, and only when holding a
-   * lock on cb_mutex (probably signaled with cb_cond) */
+  /* fid, seq, pts, last_scr, last_sof, got_bytes and fill_slot belong to the transfer
+   * callbacks. Listeners may only access the other slots, and only when
+   * holding a lock on cb_mutex (probably signaled with cb_cond) */
   uint8_t fid;
-  uint32_t seq, hold_seq;
-  uint32_t pts, hold_pts;
-  uint32_t last_scr, hold_last_scr;
-  size_t got_bytes, hold_bytes;
-  uint8_t *outbuf, *holdbuf;
+  uint32_t seq;
+  uint32_t pts;
+  uint32_t last_scr;
+  uint16_t last_sof;
+  size_t got_bytes;
+  /** set when the frame being assembled didn't fit into its slot */
+  uint8_t overflow;
+  /** enum uvc_frame_error bits of the frame being assembled */
+  uint8_t frame_errors;
+  /** payload header bits seen in the frame being assembled: PTS (1 << 2),
+   * SCR (1 << 3) */
+  uint8_t frame_info;
+  /** host monotonic time the current transfer completed, and the first
+   * payload of the frame being assembled arrived */
+  int64_t xfer_ns;
+  int64_t frame_start_ns;
+  /** host monotonic time the previous frame ended, 0 before the first */
+  int64_t last_eof_ns;
+  /** metadata gathered for the frame being assembled, and where its last
+   * entry starts */
+  size_t meta_bytes;
+  size_t meta_last;
+  /** metadata of frames copied out of their slot */
+  uint8_t frame_meta[LIBUVC_METADATA_SIZE];
+  struct uvc_clock clock;
+  struct uvc_frame_slot *slots;
+  int num_slots;
+  struct uvc_frame_slot *fill_slot;
+  uvc_stream_stats_t stats;
   pthread_mutex_t cb_mutex;
   pthread_cond_t cb_cond;
   pthread_t cb_thread;
-  uint32_t last_polled_seq;
   uvc_frame_callback_t *user_cb;
   void *user_ptr;
+  /** Stream setup flags (enum uvc_stream_flags) */
+  uint8_t flags;
+  /** Transfers and iso packets per transfer asked for, 0 picks a default */
+  int req_transfers;
+  int req_packets;
+  /** Transfers set up by uvc_stream_start */
+  int num_transfers;
+  int packets_per_transfer;
+  size_t transfer_size;
+  /** Transfers whose buffer came from libusb_dev_mem_alloc */
+  int dev_mem_transfers;
   struct libusb_transfer *transfers[LIBUVC_NUM_TRANSFER_BUFS];
   uint8_t *transfer_bufs[LIBUVC_NUM_TRANSFER_BUFS];
+  uint8_t transfer_dev_mem[LIBUVC_NUM_TRANSFER_BUFS];
+  /** UVC_STREAM_FLAG_DIRECT_BULK is in effect: the expected payload header
+   * length, where the transfer was submitted and the frame data under its
+   * header */
+  uint8_t direct;
+  size_t direct_hdr;
+  uint8_t *direct_dst;
+  uint8_t direct_stash[LIBUVC_SLOT_HEADROOM];
   struct uvc_frame frame;
+  /** Frame layout of the running stream, resolved by uvc_stream_start */
   enum uvc_frame_format frame_format;
+  uint32_t width;
+  uint32_t height;
+  size_t step;
 };
 
 /** Handle on an open UVC device
@@ -10,6 +10,161 @@ void cgo_frame_cb(uvc_frame_t *frame, void *ptr) {
 	go_frame_cb(frame, ptr);
 }
 
+// Converts the width x height image of in_format at in, whose rows are step
+// bytes apart (0 if packed), into out_format at out, which must hold
+// out_bytes bytes. Neither buffer is owned by the library. Returns
+// UVC_ERROR_NOT_SUPPORTED for conversions libuvc lacks.
+uvc_error_t cgo_uvc_convert(enum uvc_frame_format in_format, uint32_t width, uint32_t height,
+                            size_t step, void *in, size_t in_bytes,
+                            enum uvc_frame_format out_format, void *out, size_t out_bytes) {
+	uvc_frame_t src, dst;
+
+	memset(&src, 0, sizeof(src));
+	src.frame_format = in_format;
+	src.width = width;
+	src.height = height;
+	src.step = step;
+	src.data = in;
+	src.data_bytes = in_bytes;
+
+	memset(&dst, 0, sizeof(dst));
+	dst.data = out;
+	dst.data_bytes = out_bytes;
+
+	switch (out_format) {
+	case UVC_FRAME_FORMAT_RGB:
+		return uvc_any2rgb(&src, &dst);
+	case UVC_FRAME_FORMAT_BGR:
+		return uvc_any2bgr(&src, &dst);
+	case UVC_FRAME_FORMAT_GRAY8:
+		return uvc_any2y(&src, &dst);
+	default:
+		return UVC_ERROR_NOT_SUPPORTED;
+	}
+}
+
+// Demosaics the width x height Bayer image of in_format at in into RGB or
+// BGR at out, which must hold out_bytes bytes.
+uvc_error_t cgo_uvc_demosaic(enum uvc_frame_format in_format, uint32_t width, uint32_t height,
+                             void *in, size_t in_bytes, enum uvc_demosaic_method method,
+                             enum uvc_frame_format out_format, void *out, size_t out_bytes) {
+	uvc_frame_t src, dst;
+
+	memset(&src, 0, sizeof(src));
+	src.frame_format = in_format;
+	src.width = width;
+	src.height = height;
+	src.data = in;
+	src.data_bytes = in_bytes;
+
+	memset(&dst, 0, sizeof(dst));
+	dst.data = out;
+	dst.data_bytes = out_bytes;
+
+	switch (out_format) {
+	case UVC_FRAME_FORMAT_RGB:
+		return uvc_bayer2rgb(&src, &dst, method);
+	case UVC_FRAME_FORMAT_BGR:
+		return uvc_bayer2bgr(&src, &dst, method);
+	default:
+		return UVC_ERROR_NOT_SUPPORTED;
+	}
+}
+
+// Decodes the MJPEG frame at in, scaled down by scale_denom, into out_format
+// at out, which must hold out_bytes bytes. Returns UVC_ERROR_INVALID_PARAM if
+// the image doesn't fill exactly out_bytes.
+uvc_error_t cgo_uvc_mjpeg_decode(uvc_mjpeg_decoder_t *dec, void *in, size_t in_bytes, int scale_denom,
+                                 enum uvc_frame_format out_format, void *out, size_t out_bytes) {
+	uvc_frame_t src, dst;
+	uvc_error_t ret;
+
+	memset(&src, 0, sizeof(src));
+	src.frame_format = UVC_FRAME_FORMAT_MJPEG;
+	src.data = in;
+	src.data_bytes = in_bytes;
+
+	memset(&dst, 0, sizeof(dst));
+	dst.data = out;
+	dst.data_bytes = out_bytes;
+
+	ret = uvc_mjpeg_decode_scaled(dec, &src, &dst, out_format, scale_denom);
+	if (ret == UVC_SUCCESS && (size_t) dst.step * dst.height != out_bytes)
+		ret = UVC_ERROR_INVALID_PARAM;
+
+	return ret;
+}
+
+// Decodes the MJPEG frame at in into caller owned I420 planes.
+uvc_error_t cgo_uvc_mjpeg_decode_i420(uvc_mjpeg_decoder_t *dec, void *in, size_t in_bytes,
+                                      void *y, size_t y_stride, void *u, size_t u_stride,
+                                      void *v, size_t v_stride) {
+	uvc_frame_t src;
+
+	memset(&src, 0, sizeof(src));
+	src.frame_format = UVC_FRAME_FORMAT_MJPEG;
+	src.data = in;
+	src.data_bytes = in_bytes;
+
+	return uvc_mjpeg_decode_i420(dec, &src, y, y_stride, u, u_stride, v, v_stride);
+}
+
+// Converts the width x height image of in_format at in, whose rows are step
+// bytes apart (0 if packed), into caller owned planes: NV12 (y, interleaved
+// u) if v is NULL, I420 otherwise.
+uvc_error_t cgo_uvc_convert_planar(enum uvc_frame_format in_format, uint32_t width, uint32_t height,
+                                   size_t step, void *in, size_t in_bytes,
+                                   void *y, size_t y_stride, void *u, size_t u_stride,
+                                   void *v, size_t v_stride) {
+	uvc_frame_t src;
+
+	memset(&src, 0, sizeof(src));
+	src.frame_format = in_format;
+	src.width = width;
+	src.height = height;
+	src.step = step;
+	src.data = in;
+	src.data_bytes = in_bytes;
+
+	if (!v)
+		return uvc_any2nv12(&src, y, y_stride, u, u_stride);
+	return uvc_any2i420(&src, y, y_stride, u, u_stride, v, v_stride);
+}
+
+// Like uvc_stream_get_frame on a stream started without callback, but copies
+// the frame into dst and hands the buffer straight back. The frame fields stay
+// readable in strmh->frame until the next call, *size is the number of bytes
+// written. Returns UVC_ERROR_TIMEOUT if no frame completed in time,
+// UVC_ERROR_OVERFLOW (frame dropped, *size the room it needs) if it doesn't
+// fit into dst_bytes.
+uvc_error_t cgo_uvc_stream_read_frame(uvc_stream_handle_t *strmh, void *dst, size_t dst_bytes, int32_t timeout_us, size_t *size) {
+	uvc_frame_t *frame;
+	uvc_error_t ret;
+	int dht;
+
+	ret = uvc_stream_get_frame(strmh, &frame, timeout_us);
+	if (ret != UVC_SUCCESS)
+		return ret;
+	if (!frame)
+		return UVC_ERROR_TIMEOUT;
+
+	dht = (strmh->flags & UVC_STREAM_FLAG_MJPEG_DHT) && frame->frame_format == UVC_FRAME_FORMAT_MJPEG;
+	*size = frame->data_bytes + (dht ? UVC_MJPEG_DHT_BYTES : 0);
+
+	if (*size > dst_bytes) {
+		ret = UVC_ERROR_OVERFLOW;
+	} else if (dht) {
+		*size = uvc_mjpeg_copy_dht(dst, frame->data, frame->data_bytes);
+	} else {
+		memcpy(dst, frame->data, frame->data_bytes);
+	}
+
+	if (!frame->library_owns_data)
+		uvc_stream_release_buffer(strmh, frame->data, frame->sequence);
+
+	return ret;
+}
+
 // Just like uvc_get_device_list
 uvc_error_t cgo_uvc_get_device_list(uvc_context_t* ctx, cgo_uvc_device_callback_t* cb, void* ptr) {
 	uvc_error_t ret;
@@ -13,6 +13,35 @@ void cgo_device_cb(uvc_device_t* device, int index, void *ptr);
 void go_frame_cb(uvc_frame_t *frame, void *ptr);
 void cgo_frame_cb(uvc_frame_t *frame, void *ptr);
 
+// Like uvc_any2rgb/uvc_any2bgr/uvc_any2y, between caller supplied buffers
+uvc_error_t cgo_uvc_convert(enum uvc_frame_format in_format, uint32_t width, uint32_t height,
+                            size_t step, void *in, size_t in_bytes,
+                            enum uvc_frame_format out_format, void *out, size_t out_bytes);
+
+// Like uvc_bayer2rgb/uvc_bayer2bgr, between caller supplied buffers
+uvc_error_t cgo_uvc_demosaic(enum uvc_frame_format in_format, uint32_t width, uint32_t height,
+                             void *in, size_t in_bytes, enum uvc_demosaic_method method,
+                             enum uvc_frame_format out_format, void *out, size_t out_bytes);
+
+// Like uvc_mjpeg_decode_scaled, between caller supplied buffers. The image
+// must be exactly as large as out_bytes says.
+uvc_error_t cgo_uvc_mjpeg_decode(uvc_mjpeg_decoder_t *dec, void *in, size_t in_bytes, int scale_denom,
+                                 enum uvc_frame_format out_format, void *out, size_t out_bytes);
+
+// Like uvc_mjpeg_decode_i420, from a caller supplied buffer
+uvc_error_t cgo_uvc_mjpeg_decode_i420(uvc_mjpeg_decoder_t *dec, void *in, size_t in_bytes,
+                                      void *y, size_t y_stride, void *u, size_t u_stride,
+                                      void *v, size_t v_stride);
+
+// Like uvc_any2nv12 (v NULL) or uvc_any2i420, between caller supplied buffers
+uvc_error_t cgo_uvc_convert_planar(enum uvc_frame_format in_format, uint32_t width, uint32_t height,
+                                   size_t step, void *in, size_t in_bytes,
+                                   void *y, size_t y_stride, void *u, size_t u_stride,
+                                   void *v, size_t v_stride);
+
+// Like uvc_stream_get_frame, copying the frame into a caller supplied buffer
+uvc_error_t cgo_uvc_stream_read_frame(uvc_stream_handle_t *strmh, void *dst, size_t dst_bytes, int32_t timeout_us, size_t *size);
+
 uvc_error_t cgo_uvc_get_device_list(uvc_context_t *ctx, cgo_uvc_device_callback_t *cb, void* ptr);
 
 #endif
\ No newline at end of file
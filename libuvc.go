@@ -2,6 +2,6 @@ package uvc
 
 /*
 #cgo CFLAGS: -std=gnu99
-#cgo linux pkg-config: libusb-1.0
+#cgo linux pkg-config: libusb-1.0 libjpeg
 */
 import "C"
@@ -7,9 +7,13 @@ import "C"
 
 import (
 	"bytes"
+	"context"
 	"errors"
 	"fmt"
+	"io"
 	"sync"
+	"sync/atomic"
+	"time"
 	"unsafe"
 
 	"github.com/mattn/go-pointer"
@@ -17,19 +21,196 @@ import (
 
 var (
 	ErrStreamClosed = errors.New("stream closed")
+	ErrNotPulling   = errors.New("stream not started with StartPull")
 )
 
+// DropPolicy decides what happens to a frame when the frame queue is full.
+type DropPolicy int
+
+const (
+	// Drop the frame that just arrived (default).
+	DropNewest DropPolicy = iota
+	// Evict the oldest queued frame to make room, so the consumer always sees the latest frames.
+	DropOldest
+	// Wait for the consumer to make room, up to the block timeout.
+	Block
+)
+
+// StreamOption configures how a stream delivers frames.
+type StreamOption func(opts *streamOptions)
+
+type streamOptions struct {
+	frameSlots   int
+	zeroCopy     bool
+	queueDepth   int
+	dropPolicy   DropPolicy
+	blockTimeout time.Duration
+	transfers    int
+	isoPackets   int
+	directBulk   bool
+	validate     bool
+	keepCorrupt  bool
+	mjpegDHT     bool
+}
+
+// WithFrameSlots sets the number of frame buffers libuvc assembles frames into (default 2).
+// One is always being filled from the device, the others absorb consumers
+// that fall behind by up to n-1 frames. It is applied by Stream.Open.
+func WithFrameSlots(n int) StreamOption {
+	return func(opts *streamOptions) {
+		opts.frameSlots = n
+	}
+}
+
+// WithTransfers sets how many USB transfers libuvc keeps in flight and how many
+// packets each isochronous transfer carries. More or larger transfers ride out
+// longer scheduling delays without dropping data, at the cost of pinned memory.
+// Zero picks a default from the negotiated bandwidth and frame interval.
+// It is applied by Stream.Start.
+func WithTransfers(n, packetsPerTransfer int) StreamOption {
+	return func(opts *streamOptions) {
+		opts.transfers = n
+		opts.isoPackets = packetsPerTransfer
+	}
+}
+
+// WithDirectBulk receives bulk transfers straight into libuvc's frame buffer,
+// so only the payload header is stripped and the image data is never copied
+// between USB and frame buffers. It keeps a single transfer in flight and pays
+// off with a large dwMaxPayloadTransferSize. Isochronous streams ignore it.
+// It is applied by Stream.Start.
+func WithDirectBulk() StreamOption {
+	return func(opts *streamOptions) {
+		opts.directBulk = true
+	}
+}
+
+// WithValidation checks every frame before it is delivered: the payload error
+// bit for every format, and the SOI/EOI markers and a plausible size for MJPEG.
+// The checks only look at both ends of the frame, so truncated frames are
+// caught before they are copied or decoded. Corrupt frames are dropped, or
+// with keepCorrupt delivered with Frame.Errors set, and counted in StreamStats.
+// It is applied by Stream.Start.
+func WithValidation(keepCorrupt bool) StreamOption {
+	return func(opts *streamOptions) {
+		opts.validate = true
+		opts.keepCorrupt = keepCorrupt
+	}
+}
+
+// WithMJPEGHuffmanTables adds the standard Huffman tables to MJPEG frames that
+// come without them, as most UVC cameras send them, so every frame is a JPEG
+// file that image/jpeg and other decoders can read. The tables are spliced in
+// while the frame is copied out of libuvc's buffer, at no extra copy.
+// Frames delivered WithZeroCopy are left as the device sent them.
+// It is applied by Stream.Start.
+func WithMJPEGHuffmanTables() StreamOption {
+	return func(opts *streamOptions) {
+		opts.mjpegDHT = true
+	}
+}
+
+// WithZeroCopy lends the frame buffer assembled by libuvc to the consumer
+// instead of copying it into Go memory. The frame is delivered in its native
+// format, its data is only valid until Frame.Release is called, and frames
+// completed while all other frame slots are still held are dropped.
+// It is applied by Stream.Start.
+func WithZeroCopy() StreamOption {
+	return func(opts *streamOptions) {
+		opts.zeroCopy = true
+	}
+}
+
+// WithQueue sets the capacity of the frame channel and what to do when it is full.
+// The default is an unbuffered channel with DropNewest, which only delivers frames
+// to a consumer already waiting on the channel. It is applied by Stream.Start.
+func WithQueue(depth int, policy DropPolicy) StreamOption {
+	return func(opts *streamOptions) {
+		opts.queueDepth = depth
+		opts.dropPolicy = policy
+	}
+}
+
+// WithBlockTimeout sets how long the Block policy waits for room in the queue
+// before dropping the frame (default 1s). It is applied by Stream.Start.
+func WithBlockTimeout(d time.Duration) StreamOption {
+	return func(opts *streamOptions) {
+		opts.blockTimeout = d
+	}
+}
+
+// StreamStats are the frame counters of a stream.
+type StreamStats struct {
+	// Frames completed by the device
+	Frames uint64
+	// Frames libuvc dropped because all of its frame slots were in use
+	SlotDrops uint64
+	// Times libuvc enlarged a frame slot because the device sent more than dwMaxVideoFrameSize
+	SlotGrowths uint64
+	// Frames libuvc dropped because they exceeded its maximum frame size
+	Overflows uint64
+	// Frames found corrupt by WithValidation, by problem; a frame may count towards several
+	PayloadErrors uint64
+	MissingSOI    uint64
+	MissingEOI    uint64
+	BadSize       uint64
+	// Corrupt frames dropped, unless WithValidation keeps them
+	CorruptDrops uint64
+	// Frames put in the frame channel
+	Delivered uint64
+	// Frames dropped by DropNewest because the queue was full
+	DroppedNewest uint64
+	// Queued frames evicted by DropOldest
+	DroppedOldest uint64
+	// Frames dropped by Block after the timeout expired
+	TimedOut uint64
+	// Time between the ends of consecutive frames completed by the device
+	FrameIntervals Histogram
+	// Frames that ended more than 1.5 frame intervals (StreamCtrl.FrameInterval) after the previous one
+	LateFrames uint64
+	// Time from the arrival of a frame's last payload until the consumer
+	// took it, on the monotonic clock: received it from an unbuffered frame
+	// channel (the default), or took it off a buffered one with Receive or a
+	// SyncGroup, or got it from ReadFrame. Frames read from a buffered
+	// channel directly are not counted.
+	Latency Histogram
+}
+
+// queueCounters are updated atomically from the frame callback.
+type queueCounters struct {
+	delivered     uint64
+	droppedNewest uint64
+	droppedOldest uint64
+	timedOut      uint64
+}
+
 type Stream struct {
+	// first fields to keep the 64-bit counters aligned on 32-bit platforms
+	counters queueCounters
+	latency  histogramCounters
+
 	devh   *C.uvc_device_handle_t
 	handle *C.uvc_stream_handle_t
 	ctrl   C.uvc_stream_ctrl_t
+	opts   streamOptions
 	fc     chan *Frame
+	done   chan struct{}
+	timer  *time.Timer
 	p      unsafe.Pointer
 	mu     sync.RWMutex
+	// started by StartPull, ReadFrame calls are serialized by reading
+	pulling bool
+	reading sync.Mutex
+	// released frames, reused together with their data buffers
+	frames sync.Pool
+	// idle MJPEG decoders, freed by Close
+	decMu     sync.Mutex
+	decoders  []*C.uvc_mjpeg_decoder_t
+	decClosed bool
 }
 
 // Open opens a new video stream.
-func (s *Stream) Open() error {
+func (s *Stream) Open(opts ...StreamOption) error {
 	s.mu.Lock()
 	defer s.mu.Unlock()
 
@@ -37,47 +218,508 @@ func (s *Stream) Open() error {
 		return nil
 	}
 
-	r := C.uvc_stream_open_ctrl(s.devh, &s.handle, &s.ctrl)
+	for _, opt := range opts {
+		opt(&s.opts)
+	}
+
+	slots := s.opts.frameSlots
+	if slots == 0 {
+		slots = C.LIBUVC_NUM_FRAME_SLOTS
+	}
+
+	r := C.uvc_stream_open_ctrl_slots(s.devh, &s.handle, &s.ctrl, C.int(slots))
 	if err := newError(ErrorType(r)); err != nil {
 		return err
 	}
 
-	s.fc = make(chan *Frame)
 	return nil
 }
 
 // Start begins streaming video from the device into frame channel.
-func (s *Stream) Start() (<-chan *Frame, error) {
+// Frames of a previous run still queued on the channel are dropped. Start
+// fails with ERROR_BUSY while the consumer holds a zero-copy frame of a
+// previous run that it hasn't released.
+func (s *Stream) Start(opts ...StreamOption) (<-chan *Frame, error) {
+	s.mu.Lock()
+	defer s.mu.Unlock()
+
+	if s.handle == nil {
+		return nil, ErrStreamClosed
+	}
+	// the callback thread of a running stream still uses its channel and options
+	if s.running() {
+		return nil, newError(ERROR_BUSY)
+	}
+
+	o := s.opts
+	for _, opt := range opts {
+		opt(&o)
+	}
+	if o.blockTimeout <= 0 {
+		o.blockTimeout = time.Second
+	}
+
+	depth := o.queueDepth
+	if o.dropPolicy == DropOldest && depth < 1 {
+		depth = 1
+	}
+	// frames a previous run left queued keep their slots lent, and libuvc
+	// refuses to start while any slot is lent
+	s.drain()
+	fc := s.fc
+	if fc == nil || cap(fc) != depth {
+		fc = make(chan *Frame, depth)
+	}
+	if s.timer == nil {
+		s.timer = time.NewTimer(o.blockTimeout)
+		s.timer.Stop()
+	}
+
+	done := make(chan struct{})
+	run := &streamRun{s: s, done: done, fc: fc, opts: o}
+	p := pointer.Save(run)
+	if err := s.start(&o, (*C.uvc_frame_callback_t)(unsafe.Pointer(C.cgo_frame_cb)), p); err != nil {
+		pointer.Unref(p)
+		return nil, err
+	}
+
+	if s.fc != nil && s.fc != fc {
+		close(s.fc)
+	}
+	s.opts = o
+	s.fc = fc
+	s.done = done
+	s.p = p
+
+	return fc, nil
+}
+
+// StartPull begins streaming video without a frame callback or channel;
+// frames are read with ReadFrame instead. Zero-copy and queue options don't apply.
+func (s *Stream) StartPull(opts ...StreamOption) error {
+	s.mu.Lock()
+	defer s.mu.Unlock()
+
+	if s.handle == nil {
+		return ErrStreamClosed
+	}
+	if s.running() {
+		return newError(ERROR_BUSY)
+	}
+
+	o := s.opts
+	for _, opt := range opts {
+		opt(&o)
+	}
+
+	if err := s.start(&o, nil, nil); err != nil {
+		return err
+	}
+	s.opts = o
+	s.pulling = true
+
+	return nil
+}
+
+// running reports whether Start or StartPull started the stream and Stop
+// hasn't stopped it yet, the caller holds s.mu.
+func (s *Stream) running() bool {
+	return s.done != nil || s.pulling
+}
+
+// start starts libuvc streaming with opts, the caller holds s.mu.
+func (s *Stream) start(o *streamOptions, cb *C.uvc_frame_callback_t, p unsafe.Pointer) error {
+	// frames are always lent by libuvc, the copy into Go memory (if any)
+	// happens once in the frame callback or ReadFrame
+	var flags C.uint8_t = C.UVC_STREAM_FLAG_ZERO_COPY
+	if o.directBulk {
+		flags |= C.UVC_STREAM_FLAG_DIRECT_BULK
+	}
+	if o.mjpegDHT {
+		flags |= C.UVC_STREAM_FLAG_MJPEG_DHT
+	}
+	if o.validate {
+		flags |= C.UVC_STREAM_FLAG_VALIDATE
+		if o.keepCorrupt {
+			flags |= C.UVC_STREAM_FLAG_KEEP_CORRUPT
+		}
+	}
+
+	r := C.uvc_stream_set_transfers(s.handle, C.int(o.transfers), C.int(o.isoPackets))
+	if err := newError(ErrorType(r)); err != nil {
+		return err
+	}
+
+	r = C.uvc_stream_start(s.handle, cb, p, flags)
+	return newError(ErrorType(r))
+}
+
+// FrameInfo describes a frame read by Stream.ReadFrame.
+type FrameInfo struct {
+	// Width of image in pixels
+	Width int
+	// Height of image in pixels
+	Height int
+	// Pixel data format
+	FrameFormat FrameFormat
+	// Number of bytes per horizontal line (undefined for compressed format)
+	Step int
+	// Frame number (may skip, but is strictly monotonically increasing)
+	Sequence uint32
+	// Estimate of system time when the device started capturing the image
+	CaptureTime time.Time
+	// System time the last payload of the frame arrived
+	ArrivalTime time.Time
+	// Raw device timestamps, see Frame
+	PTS    uint32
+	SCR    uint32
+	SOF    uint16
+	HasPTS bool
+	HasSCR bool
+	// Integrity problems found by WithValidation
+	Errors FrameError
+	// Size of the image data in bytes
+	Size int
+}
+
+// readFramePoll bounds how long ReadFrame blocks in libuvc before it checks its context again.
+const readFramePoll = 100 * time.Millisecond
+
+// ReadFrame waits for the next frame of a stream started with StartPull and
+// copies its image data into dst, on the calling goroutine and without allocating.
+// If dst is too small, the frame is dropped and io.ErrShortBuffer is returned
+// together with its FrameInfo, whose Size tells how large dst needs to be.
+// It returns ctx.Err() once ctx is done.
+func (s *Stream) ReadFrame(ctx context.Context, dst []byte) (FrameInfo, error) {
+	s.reading.Lock()
+	defer s.reading.Unlock()
+
+	for {
+		if err := ctx.Err(); err != nil {
+			return FrameInfo{}, err
+		}
+
+		wait := readFramePoll
+		if deadline, ok := ctx.Deadline(); ok {
+			if d := time.Until(deadline); d < wait {
+				wait = d
+			}
+		}
+		// libuvc waits forever for 0
+		if wait < time.Microsecond {
+			wait = time.Microsecond
+		}
+
+		info, ok, err := s.readFrame(dst, wait)
+		if ok || err != nil {
+			return info, err
+		}
+	}
+}
+
+// readFrame reads one frame, waiting up to wait. ok is false if none arrived in time.
+func (s *Stream) readFrame(dst []byte, wait time.Duration) (info FrameInfo, ok bool, err error) {
 	s.mu.RLock()
 	defer s.mu.RUnlock()
 
 	if s.handle == nil {
+		return info, false, ErrStreamClosed
+	}
+	if !s.pulling {
+		return info, false, ErrNotPulling
+	}
+
+	var p unsafe.Pointer
+	if len(dst) > 0 {
+		p = unsafe.Pointer(&dst[0])
+	}
+
+	var size C.size_t
+	r := ErrorType(C.cgo_uvc_stream_read_frame(s.handle, p, C.size_t(len(dst)), C.int32_t(wait/time.Microsecond), &size))
+	switch r {
+	case ERROR_TIMEOUT:
+		return info, false, nil
+	case SUCCESS, ERROR_OVERFLOW:
+		frame := &s.handle.frame
+		info = FrameInfo{
+			Width:       int(frame.width),
+			Height:      int(frame.height),
+			FrameFormat: FrameFormat(frame.frame_format),
+			Step:        int(frame.step),
+			Sequence:    uint32(frame.sequence),
+			CaptureTime: time.Unix(int64(frame.capture_time.tv_sec), int64(frame.capture_time.tv_usec)*1000),
+			ArrivalTime: time.Unix(int64(frame.arrival_time.tv_sec), int64(frame.arrival_time.tv_usec)*1000),
+			PTS:         uint32(frame.pts),
+			SCR:         uint32(frame.scr),
+			SOF:         uint16(frame.sof),
+			HasPTS:      frame.has_pts != 0,
+			HasSCR:      frame.has_scr != 0,
+			Errors:      FrameError(frame.errors),
+			Size:        int(size),
+		}
+		if r == ERROR_OVERFLOW {
+			return info, true, io.ErrShortBuffer
+		}
+		s.received(frame.arrival_ns)
+		return info, true, nil
+	default:
+		return info, false, newError(r)
+	}
+}
+
+// Receive takes the next frame off the channel returned by Start, so that
+// its latency is counted in StreamStats.Latency even if the channel is
+// buffered. It returns ErrStreamClosed once the channel is closed or if the
+// stream was never started, and ctx.Err() once ctx is done.
+func (s *Stream) Receive(ctx context.Context) (*Frame, error) {
+	s.mu.RLock()
+	fc := s.fc
+	s.mu.RUnlock()
+
+	if fc == nil {
 		return nil, ErrStreamClosed
 	}
 
-	s.p = pointer.Save(s.fc)
-	r := C.uvc_stream_start(s.handle,
-		(*C.uvc_frame_callback_t)(unsafe.Pointer(C.cgo_frame_cb)), s.p, 0)
-	if err := newError(ErrorType(r)); err != nil {
-		return nil, err
+	select {
+	case fr, ok := <-fc:
+		if !ok {
+			return nil, ErrStreamClosed
+		}
+		s.took(fr, fc)
+		return fr, nil
+	case <-ctx.Done():
+		return nil, ctx.Err()
 	}
+}
 
-	return s.fc, nil
+// streamRun is what the frame callback of one Start gets: the stream, and
+// its done channel, frame channel and options as they were when streaming
+// started.
+type streamRun struct {
+	s    *Stream
+	done <-chan struct{}
+	fc   chan *Frame
+	opts streamOptions
 }
 
-func (s *Stream) Stop() error {
+// deliver queues a frame on run.fc according to the drop policy; run.done
+// is closed when the stream is being stopped.
+// It runs on the libuvc callback thread, so the stream can not be closed underneath it.
+func (s *Stream) deliver(fr *Frame, run *streamRun) {
+	// the frame is the consumer's once sent
+	arrival := fr.arrivalNs
+
+	switch run.opts.dropPolicy {
+	case DropOldest:
+		for {
+			select {
+			case run.fc <- fr:
+				s.delivered(arrival, run.fc)
+				return
+			default:
+			}
+
+			select {
+			case old := <-run.fc:
+				atomic.AddUint64(&s.counters.droppedOldest, 1)
+				s.drop(old)
+			default:
+			}
+		}
+
+	case Block:
+		s.timer.Reset(run.opts.blockTimeout)
+		select {
+		case run.fc <- fr:
+			s.delivered(arrival, run.fc)
+		case <-s.timer.C:
+			atomic.AddUint64(&s.counters.timedOut, 1)
+			s.drop(fr)
+			return
+		case <-run.done:
+			s.drop(fr)
+		}
+		if !s.timer.Stop() {
+			<-s.timer.C
+		}
+
+	default:
+		select {
+		case run.fc <- fr:
+			s.delivered(arrival, run.fc)
+		default:
+			atomic.AddUint64(&s.counters.droppedNewest, 1)
+			s.drop(fr)
+		}
+	}
+}
+
+// delivered counts a frame sent to the consumer. A send on an unbuffered
+// channel only completes once the consumer takes the frame, which ends its
+// latency.
+func (s *Stream) delivered(arrivalNs C.int64_t, fc chan *Frame) {
+	atomic.AddUint64(&s.counters.delivered, 1)
+	if cap(fc) == 0 {
+		s.received(arrivalNs)
+	}
+}
+
+// took records the latency of a frame the consumer took off fc, unless
+// the send already did.
+func (s *Stream) took(fr *Frame, fc <-chan *Frame) {
+	if cap(fc) > 0 {
+		s.received(fr.arrivalNs)
+	}
+}
+
+// received records the latency of a frame the consumer took, from the
+// monotonic arrival time of its last payload.
+func (s *Stream) received(arrivalNs C.int64_t) {
+	s.latency.add(time.Duration(C.uvc_monotonic_ns() - arrivalNs))
+}
+
+// drop discards a frame that never reached the consumer.
+// Only for use on the callback thread, see deliver.
+func (s *Stream) drop(fr *Frame) {
+	if !fr.unref() {
+		return
+	}
+	if fr.lender != nil {
+		C.uvc_stream_release_buffer(s.handle, fr.lent, fr.lentSeq)
+	}
+	fr.recycle()
+}
+
+// drain drops the frames still queued on s.fc while the stream is stopped.
+func (s *Stream) drain() {
+	for {
+		select {
+		case fr := <-s.fc:
+			s.drop(fr)
+		default:
+			return
+		}
+	}
+}
+
+// newFrame takes a frame from the pool, holding one reference.
+func (s *Stream) newFrame() *Frame {
+	fr, _ := s.frames.Get().(*Frame)
+	if fr == nil {
+		fr = &Frame{pool: &s.frames, stream: s}
+	}
+	fr.refs = 1
+	return fr
+}
+
+// Stats returns a snapshot of the stream's frame counters.
+func (s *Stream) Stats() StreamStats {
+	s.mu.RLock()
+	defer s.mu.RUnlock()
+
+	st := StreamStats{
+		Delivered:     atomic.LoadUint64(&s.counters.delivered),
+		DroppedNewest: atomic.LoadUint64(&s.counters.droppedNewest),
+		DroppedOldest: atomic.LoadUint64(&s.counters.droppedOldest),
+		TimedOut:      atomic.LoadUint64(&s.counters.timedOut),
+	}
+	s.latency.snapshot(&st.Latency)
+	if s.handle != nil {
+		var cst C.uvc_stream_stats_t
+		C.uvc_stream_get_stats(s.handle, &cst)
+		st.Frames = uint64(cst.frames)
+		st.SlotDrops = uint64(cst.dropped_frames)
+		st.SlotGrowths = uint64(cst.grown_slots)
+		st.Overflows = uint64(cst.overflowed_frames)
+		st.PayloadErrors = uint64(cst.payload_errors)
+		st.MissingSOI = uint64(cst.missing_soi)
+		st.MissingEOI = uint64(cst.missing_eoi)
+		st.BadSize = uint64(cst.bad_size)
+		st.CorruptDrops = uint64(cst.corrupt_frames)
+		histogramFromC(&cst.frame_intervals, &st.FrameIntervals)
+		st.LateFrames = uint64(cst.late_frames)
+	}
+	return st
+}
+
+// TransferInfo describes the USB transfers of a running stream.
+type TransferInfo struct {
+	// Transfers kept in flight
+	Transfers int
+	// Packets per isochronous transfer, 0 for bulk streams
+	PacketsPerTransfer int
+	// Bytes per transfer
+	TransferSize int
+	// Transfers whose buffers libusb allocated for DMA (usbfs zero-copy, Linux).
+	// The others are bounced through a copy in the kernel.
+	DevMemTransfers int
+}
+
+// Transfers returns the transfers set up by the last Start.
+func (s *Stream) Transfers() TransferInfo {
 	s.mu.RLock()
 	defer s.mu.RUnlock()
 
+	if s.handle == nil {
+		return TransferInfo{}
+	}
+
+	var n, packets, devMem C.int
+	var size C.size_t
+	C.uvc_stream_get_transfers(s.handle, &n, &packets, &size, &devMem)
+	return TransferInfo{
+		Transfers:          int(n),
+		PacketsPerTransfer: int(packets),
+		TransferSize:       int(size),
+		DevMemTransfers:    int(devMem),
+	}
+}
+
+// releaseBuffer hands a lent frame buffer back to libuvc.
+func (s *Stream) releaseBuffer(data unsafe.Pointer, seq C.uint32_t) {
+	s.mu.RLock()
+	defer s.mu.RUnlock()
+
+	if s.handle == nil {
+		return
+	}
+	C.uvc_stream_release_buffer(s.handle, data, seq)
+}
+
+func (s *Stream) Stop() error {
+	s.mu.Lock()
+	defer s.mu.Unlock()
+
 	if s.handle == nil {
 		return ErrStreamClosed
 	}
 
-	pointer.Unref(s.p)
+	return s.stop()
+}
+
+// stop stops streaming, the caller holds s.mu.
+func (s *Stream) stop() error {
+	// unblock a callback waiting for room in the queue; it holds its own
+	// copy of the channel, so the field is only cleared once the callback
+	// thread is gone
+	if s.done != nil {
+		close(s.done)
+	}
+	s.pulling = false
 	r := C.uvc_stream_stop(s.handle)
+	s.done = nil
+	if s.p != nil {
+		pointer.Unref(s.p)
+		s.p = nil
+	}
 	return newError(ErrorType(r))
 }
 
+// Close stops and closes the stream. Frames still queued on the channel are
+// dropped. Close fails with ERROR_BUSY, leaving the stream stopped but open,
+// while the consumer holds zero-copy frames (WithZeroCopy) it hasn't
+// released: their data lives in the stream's buffers. Release them and call
+// Close again.
 func (s *Stream) Close() error {
 	s.mu.Lock()
 	defer s.mu.Unlock()
@@ -86,13 +728,62 @@ func (s *Stream) Close() error {
 		return nil
 	}
 
+	s.stop()
+	s.drain()
+	if C.uvc_stream_lent_buffers(s.handle) > 0 {
+		return newError(ERROR_BUSY)
+	}
 	C.uvc_stream_close(s.handle)
 	s.handle = nil
-	close(s.fc)
+	s.freeDecoders()
+	if s.fc != nil {
+		close(s.fc)
+		s.fc = nil
+	}
 
 	return nil
 }
 
+// decoder takes an idle MJPEG decoder, or makes one if all are busy, so
+// frames decoded concurrently don't wait for each other.
+func (s *Stream) decoder() *C.uvc_mjpeg_decoder_t {
+	s.decMu.Lock()
+	if n := len(s.decoders); n > 0 {
+		dec := s.decoders[n-1]
+		s.decoders = s.decoders[:n-1]
+		s.decMu.Unlock()
+		return dec
+	}
+	s.decMu.Unlock()
+
+	return C.uvc_mjpeg_decoder_create()
+}
+
+// putDecoder hands a decoder back for reuse, or frees it if the stream is
+// closed.
+func (s *Stream) putDecoder(dec *C.uvc_mjpeg_decoder_t) {
+	s.decMu.Lock()
+	if !s.decClosed {
+		s.decoders = append(s.decoders, dec)
+		s.decMu.Unlock()
+		return
+	}
+	s.decMu.Unlock()
+
+	C.uvc_mjpeg_decoder_destroy(dec)
+}
+
+func (s *Stream) freeDecoders() {
+	s.decMu.Lock()
+	defer s.decMu.Unlock()
+
+	for _, dec := range s.decoders {
+		C.uvc_mjpeg_decoder_destroy(dec)
+	}
+	s.decoders = nil
+	s.decClosed = true
+}
+
 func (s *Stream) IsClosed() bool {
 	s.mu.RLock()
 	defer s.mu.RUnlock()
@@ -0,0 +1,294 @@
+package uvc
+
+import (
+	"sync"
+	"sync/atomic"
+	"time"
+)
+
+// SyncGroup matches the frames of several streams, such as the cameras of a
+// stereo or multi-camera rig, by capture time. It delivers one frame of every
+// stream at a time, all captured within the tolerance of each other.
+//
+// Frames are matched on Frame.CaptureTime, which libuvc recovers from the
+// device clocks, so the match doesn't depend on when the frames arrived.
+// Frames are passed on as they are, never copied.
+type SyncGroup struct {
+	// first field to keep the 64-bit counters aligned on 32-bit platforms
+	counters syncCounters
+
+	streams   []*Stream
+	tolerance time.Duration
+	depth     int
+
+	mu sync.Mutex
+	// frame channels of the streams
+	fcs  []<-chan *Frame
+	in   chan syncFrame
+	out  chan []*Frame
+	stop chan struct{}
+	wg   sync.WaitGroup
+	// frames waiting for a match, per stream in capture order
+	queues [][]*Frame
+}
+
+// SyncStats are the counters of a sync group.
+type SyncStats struct {
+	// Frame sets delivered
+	Matched uint64
+	// Frames discarded because no frame of another stream was captured close
+	// enough, or because their stream's queue was full
+	Unmatched uint64
+}
+
+type syncCounters struct {
+	matched   uint64
+	unmatched uint64
+}
+
+type syncFrame struct {
+	stream int
+	frame  *Frame
+}
+
+// NewSyncGroup creates a sync group for streams, which must be open.
+// Frames of a stream whose capture times are at most tolerance apart from
+// a frame of every other stream are matched. Up to depth frames per stream
+// wait for their match (default 4).
+func NewSyncGroup(tolerance time.Duration, depth int, streams ...*Stream) *SyncGroup {
+	if depth <= 0 {
+		depth = 4
+	}
+	return &SyncGroup{
+		streams:   streams,
+		tolerance: tolerance,
+		depth:     depth,
+	}
+}
+
+// Start starts every stream of the group with opts and returns the channel
+// the matched frames are delivered on, one per stream in the order the streams
+// were given. Each frame is released by the consumer as usual. The channel
+// is closed by Stop.
+func (g *SyncGroup) Start(opts ...StreamOption) (<-chan []*Frame, error) {
+	g.mu.Lock()
+	defer g.mu.Unlock()
+
+	if g.stop != nil {
+		return nil, newError(ERROR_BUSY)
+	}
+
+	chans := make([]<-chan *Frame, len(g.streams))
+	for i, s := range g.streams {
+		fc, err := s.Start(opts...)
+		if err != nil {
+			for _, s := range g.streams[:i] {
+				s.Stop()
+			}
+			return nil, err
+		}
+		chans[i] = fc
+	}
+
+	g.run(chans)
+	return g.out, nil
+}
+
+// run starts matching the frames of chans, one per stream; the caller holds g.mu.
+func (g *SyncGroup) run(chans []<-chan *Frame) {
+	g.fcs = chans
+	g.in = make(chan syncFrame, len(chans))
+	g.out = make(chan []*Frame, g.depth)
+	g.stop = make(chan struct{})
+	g.queues = make([][]*Frame, len(chans))
+	for i := range g.queues {
+		g.queues[i] = make([]*Frame, 0, g.depth)
+	}
+
+	for i, fc := range chans {
+		g.wg.Add(1)
+		go g.forward(i, fc)
+	}
+	g.wg.Add(1)
+	go g.match()
+}
+
+// Stop stops every stream of the group and releases the frames still
+// waiting for a match, passed on to the matcher or queued by the streams.
+func (g *SyncGroup) Stop() error {
+	g.mu.Lock()
+	defer g.mu.Unlock()
+
+	if g.stop == nil {
+		return nil
+	}
+
+	var err error
+	for _, s := range g.streams {
+		if e := s.Stop(); e != nil && err == nil {
+			err = e
+		}
+	}
+
+	g.halt()
+	return err
+}
+
+// halt stops matching once the streams are stopped and releases every frame
+// it still holds; the caller holds g.mu.
+func (g *SyncGroup) halt() {
+	close(g.stop)
+	g.wg.Wait()
+	g.stop = nil
+
+	for i, q := range g.queues {
+		for _, fr := range q {
+			fr.Release()
+		}
+		g.queues[i] = q[:0]
+	}
+	// the forwarders and the matcher are gone, nothing else receives from g.in
+	for len(g.in) > 0 {
+		sf := <-g.in
+		sf.frame.Release()
+	}
+	for _, fc := range g.fcs {
+		drainFrames(fc)
+	}
+	g.fcs = nil
+}
+
+// Stats returns a snapshot of the group's counters.
+func (g *SyncGroup) Stats() SyncStats {
+	return SyncStats{
+		Matched:   atomic.LoadUint64(&g.counters.matched),
+		Unmatched: atomic.LoadUint64(&g.counters.unmatched),
+	}
+}
+
+// drainFrames releases the frames queued on fc, without waiting for more.
+func drainFrames(fc <-chan *Frame) {
+	for {
+		select {
+		case fr, ok := <-fc:
+			if !ok {
+				return
+			}
+			fr.Release()
+		default:
+			return
+		}
+	}
+}
+
+// forward passes the frames of one stream on to the matcher.
+func (g *SyncGroup) forward(i int, fc <-chan *Frame) {
+	defer g.wg.Done()
+
+	for {
+		select {
+		case fr, ok := <-fc:
+			if !ok {
+				return
+			}
+			if fr.stream != nil {
+				fr.stream.took(fr, fc)
+			}
+			select {
+			case g.in <- syncFrame{i, fr}:
+			case <-g.stop:
+				fr.Release()
+				return
+			}
+		case <-g.stop:
+			return
+		}
+	}
+}
+
+// match queues the frames of all streams and delivers every complete match.
+func (g *SyncGroup) match() {
+	defer g.wg.Done()
+	defer close(g.out)
+
+	for {
+		select {
+		case sf := <-g.in:
+			g.add(sf.stream, sf.frame)
+			for {
+				set := g.next()
+				if set == nil {
+					break
+				}
+				select {
+				case g.out <- set:
+					atomic.AddUint64(&g.counters.matched, 1)
+				case <-g.stop:
+					for _, fr := range set {
+						fr.Release()
+					}
+					return
+				}
+			}
+		case <-g.stop:
+			return
+		}
+	}
+}
+
+// add queues a frame of stream i, evicting its oldest frame if the queue is full.
+func (g *SyncGroup) add(i int, fr *Frame) {
+	q := g.queues[i]
+	if len(q) == g.depth {
+		g.discard(i)
+		q = g.queues[i]
+	}
+	g.queues[i] = append(q, fr)
+}
+
+// discard releases the oldest queued frame of stream i.
+func (g *SyncGroup) discard(i int) {
+	q := g.queues[i]
+	q[0].Release()
+	n := copy(q, q[1:])
+	q[n] = nil
+	g.queues[i] = q[:n]
+	atomic.AddUint64(&g.counters.unmatched, 1)
+}
+
+// next takes the oldest frame of every stream if they match, or nil.
+//
+// If the oldest frames of all streams are further apart than the tolerance,
+// the earliest of them can't match anymore: every later frame of the other
+// streams was captured even later. It is discarded and the next ones tried.
+func (g *SyncGroup) next() []*Frame {
+	for {
+		first, last := -1, -1
+		for i, q := range g.queues {
+			if len(q) == 0 {
+				return nil
+			}
+			t := q[0].CaptureTime
+			if first < 0 || t.Before(g.queues[first][0].CaptureTime) {
+				first = i
+			}
+			if last < 0 || t.After(g.queues[last][0].CaptureTime) {
+				last = i
+			}
+		}
+
+		if g.queues[last][0].CaptureTime.Sub(g.queues[first][0].CaptureTime) > g.tolerance {
+			g.discard(first)
+			continue
+		}
+
+		set := make([]*Frame, len(g.queues))
+		for i, q := range g.queues {
+			set[i] = q[0]
+			n := copy(q, q[1:])
+			q[n] = nil
+			g.queues[i] = q[:n]
+		}
+		return set
+	}
+}
@@ -0,0 +1,90 @@
+package uvc
+
+import (
+	"sync"
+	"sync/atomic"
+	"testing"
+	"time"
+)
+
+// feedSyncGroup sends frames of the same capture times to every channel in
+// turn until the group stops taking them, and returns the frames it sent.
+func feedSyncGroup(pool *sync.Pool, chans []chan *Frame) []*Frame {
+	var sent []*Frame
+	t := time.Now()
+	for {
+		for _, fc := range chans {
+			fr := &Frame{pool: pool, refs: 1, CaptureTime: t}
+			select {
+			case fc <- fr:
+				sent = append(sent, fr)
+			case <-time.After(100 * time.Millisecond):
+				return sent
+			}
+		}
+		t = t.Add(33 * time.Millisecond)
+	}
+}
+
+func startSyncGroup(g *SyncGroup, chans []chan *Frame) {
+	in := make([]<-chan *Frame, len(chans))
+	for i, fc := range chans {
+		in[i] = fc
+	}
+	g.mu.Lock()
+	g.run(in)
+	g.mu.Unlock()
+}
+
+// TestSyncGroupRestart stops a group with frames at every stage of matching:
+// queued by the streams, being passed on to the matcher, and matched but not
+// delivered. Stop must release them all, and the group must start again.
+func TestSyncGroupRestart(t *testing.T) {
+	var pool sync.Pool
+	g := NewSyncGroup(time.Millisecond, 4)
+
+	chans := []chan *Frame{make(chan *Frame, 2), make(chan *Frame, 2)}
+	startSyncGroup(g, chans)
+	// the output fills up, the matcher blocks on the next set, and its input
+	// and the stream channels fill up behind it
+	sent := feedSyncGroup(&pool, chans)
+	if len(g.in) < cap(g.in) {
+		t.Fatalf("matcher input %d/%d after sending %d frames", len(g.in), cap(g.in), len(sent))
+	}
+
+	out := g.out
+	g.mu.Lock()
+	g.halt()
+	g.mu.Unlock()
+
+	for set := range out {
+		for _, fr := range set {
+			fr.Release()
+		}
+	}
+	for i, fr := range sent {
+		if refs := atomic.LoadInt32(&fr.refs); refs != 0 {
+			t.Errorf("frame %d of stream %d holds %d references after Stop", i/2, i%2, refs)
+		}
+	}
+
+	chans = []chan *Frame{make(chan *Frame, 1), make(chan *Frame, 1)}
+	startSyncGroup(g, chans)
+	now := time.Now()
+	for _, fc := range chans {
+		fc <- &Frame{pool: &pool, refs: 1, CaptureTime: now}
+	}
+
+	select {
+	case set := <-g.out:
+		if len(set) != 2 {
+			t.Errorf("matched %d frames, want 2", len(set))
+		}
+	case <-time.After(time.Second):
+		t.Error("no match after restarting")
+	}
+
+	g.mu.Lock()
+	g.halt()
+	g.mu.Unlock()
+}